@@ -10,6 +10,8 @@
 
 #include "rng/mwc.h"
 
+#include "bitmap_mirror.h"
+#include "heap_snapshot.h"
 #include "mini_heap.h"
 
 // invariants:
@@ -104,6 +106,35 @@ public:
     return bucket;
   }
 
+  // copies the mirrored rows of our meshing candidates into rows.
+  // Filtering on fullness works off the mirrored bitmaps, so no
+  // MiniHeap metadata is read.
+  void meshingCandidates(double occupancyCutoff, BitmapMirror &rows) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    rows.clear();
+    rows.setObjectCount(_objectCount);
+
+    // mirrors only hold partial bins, whose miniheaps are all
+    // detached, so this is isMeshingCandidate for the whole class
+    if (_objectCount < 2)
+      return;
+
+    const size_t cutoff = occupancyCutoff * _objectCount;
+
+    rows.reserve(partialSizeLocked());
+    for (size_t i = 0; i < kBinnedTrackerBinCount; i++) {
+      const auto &mirror = _partialMirror[i];
+      if (i == kBinnedTrackerBinCount / 2 + 1 && rows.size() == 0) {
+        break;
+      }
+      for (size_t j = 0; j < mirror.size(); j++) {
+        if (mirror.inUseCount(j) < cutoff)
+          rows.pushRow(mirror, j);
+      }
+    }
+  }
+
   // called after a free through the global heap has happened --
   // miniheap must be unreffed by return
   bool postFree(MiniHeap *mh, uint32_t inUseCount) {
@@ -116,8 +147,13 @@ public:
     auto oldBinId = mh->getBinToken().bin();
     auto newBinId = getBinId(inUseCount);
 
-    if (likely(newBinId == oldBinId))
+    if (likely(newBinId == oldBinId)) {
+      if (isPartialBin(oldBinId)) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        refreshMirrorLocked(mh);
+      }
       return false;
+    }
 
     std::lock_guard<std::mutex> lock(_mutex);
 
@@ -125,6 +161,7 @@ public:
     oldBinId = mh->getBinToken().bin();
     newBinId = getBinId(mh->inUseCount());
     if (unlikely(newBinId == oldBinId)) {
+      refreshMirrorLocked(mh);
       return false;
     }
 
@@ -233,6 +270,24 @@ public:
     }
   }
 
+  // appends a snapshot record for every miniheap we track, and for
+  // every miniheap meshed into them
+  void snapshot(internal::vector<snapshot::Record> &records) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (size_t i = 0; i < _full.size(); i++) {
+      snapshotChain(_full[i], records);
+    }
+    for (size_t i = 0; i < kBinnedTrackerBinCount; i++) {
+      for (size_t j = 0; j < _partial[i].size(); j++) {
+        snapshotChain(_partial[i][j], records);
+      }
+    }
+    for (size_t i = 0; i < _empty.size(); i++) {
+      snapshotChain(_empty[i], records);
+    }
+  }
+
   void dumpStats(bool beDetailed) const {
     std::lock_guard<std::mutex> lock(_mutex);
 
@@ -283,6 +338,28 @@ public:
   }
 
 private:
+  static void snapshotChain(const MiniHeap *head, internal::vector<snapshot::Record> &records) {
+    if (head == nullptr)
+      return;
+
+    const uint32_t headId = GetMiniHeapID(head).value();
+    head->forEachMeshed([&](const MiniHeap *mh) {
+      snapshot::Record record{};
+      const internal::Bitmap::word_t *bits = mh->bitmap().bits();
+      for (size_t w = 0; w < 4; w++) {
+        record.bitmap[w] = bits[w].load(std::memory_order_relaxed);
+      }
+      record.id = GetMiniHeapID(mh).value();
+      record.chainHead = headId;
+      record.sizeClass = mh->sizeClass();
+      record.objectCount = mh->maxCount();
+      record.meshCount = mh->meshCount();
+      record.flags = (mh->isAttached() ? snapshot::Attached : 0) | (mh->isMeshed() ? snapshot::Meshed : 0);
+      records.push_back(record);
+      return false;
+    });
+  }
+
   // remove and return a MiniHeap uniformly at random from the given vector
   MiniHeap *popRandomLocked(internal::vector<MiniHeap *> &vec) {
     for (size_t i = 0; i < 16; i++) {
@@ -339,6 +416,12 @@ private:
 
     std::swap(vec[swapOff], vec[endOff]);
     swapTokens(vec[swapOff], vec[endOff]);
+
+    auto mirror = mirrorFor(vec);
+    if (mirror != nullptr) {
+      mirror->push(mh);
+      mirror->swap(swapOff, endOff);
+    }
   }
 
   // must be called with _mutex held
@@ -357,6 +440,12 @@ private:
     vec[endOff] = nullptr;
     vec.pop_back();
 
+    auto mirror = mirrorFor(vec);
+    if (mirror != nullptr) {
+      mirror->swap(off, endOff);
+      mirror->pop();
+    }
+
     // for (size_t i = 0; i < vec.size(); i++) {
     //   if (vec[i] == mh) {
     //     mesh::debug("!!!! not actually removed?");
@@ -369,6 +458,31 @@ private:
     mh->setBinToken(mh->getBinToken().newOff(internal::bintoken::FlagNoOff));
   }
 
+  // the bitmap mirror parallel to vec, if vec is one of our partial bins
+  BitmapMirror *mirrorFor(const internal::vector<MiniHeap *> &vec) {
+    if (&vec < &_partial[0] || &vec >= &_partial[kBinnedTrackerBinCount])
+      return nullptr;
+    return &_partialMirror[&vec - &_partial[0]];
+  }
+
+  static bool isPartialBin(uint32_t bin) {
+    return bin != internal::bintoken::FlagFull && bin != internal::bintoken::FlagEmpty;
+  }
+
+  // frees that leave a miniheap in the same partial bin don't move
+  // it, but its mirrored bitmap still has to reflect them (as do
+  // objects consumed into a mesh destination).  Must be called with
+  // _mutex held.
+  void refreshMirrorLocked(MiniHeap *mh) {
+    const auto token = mh->getBinToken();
+    if (!token.valid() || !isPartialBin(token.bin()))
+      return;
+
+    auto &mirror = _partialMirror[token.bin()];
+    d_assert(_partial[token.bin()][token.off()] == mh);
+    mirror.update(token.off(), mh);
+  }
+
   uint32_t getBinId(uint32_t inUseCount) const {
     if (inUseCount == _objectCount) {
       return internal::bintoken::FlagFull;
@@ -403,6 +517,7 @@ private:
 
   internal::vector<MiniHeap *> _full;
   internal::vector<MiniHeap *> _partial[kBinnedTrackerBinCount];
+  BitmapMirror _partialMirror[kBinnedTrackerBinCount];
   internal::vector<MiniHeap *> _empty;
 };
 }  // namespace mesh
@@ -0,0 +1,220 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil -*-
+// Copyright 2018 Bobby Powers
+
+#pragma once
+#ifndef MESH__BITMAP_MIRROR_H
+#define MESH__BITMAP_MIRROR_H
+
+#include "internal.h"
+
+#include "rng/mwc.h"
+
+#include "mini_heap.h"
+
+namespace mesh {
+
+// A densely packed, structure-of-arrays copy of the occupancy bitmaps
+// (plus IDs and mesh counts) of a set of MiniHeaps.  BinnedTracker
+// keeps one per partial bin, row-for-row parallel with the bin's
+// vector of MiniHeap pointers, so that searching for meshes streams
+// through contiguous 32-byte bitmaps instead of chasing a pointer into
+// the MiniHeap metadata arena for every candidate.
+//
+// Each row also carries an 8-bit occupancy signature: the span's
+// objects are split into kSignatureBits equal chunks, and bit c is set
+// if chunk c has any live object.  Rows with disjoint signatures are
+// always meshable, without comparing their bitmaps.
+class BitmapMirror {
+private:
+  DISALLOW_COPY_AND_ASSIGN(BitmapMirror);
+
+public:
+  static constexpr size_t kWords = 4;
+  static constexpr size_t kSignatureBits = 8;
+
+  static_assert(sizeof(internal::Bitmap::word_t) == sizeof(uint64_t), "mirrored words must match bitmap words");
+
+  BitmapMirror() {
+  }
+
+  inline size_t size() const {
+    return _ids.size();
+  }
+
+  inline bool empty() const {
+    return _ids.empty();
+  }
+
+  // sizes signature chunks for spans of objectCount objects, so that
+  // small spans still spread over all kSignatureBits chunks.  Must be
+  // called before rows are added.
+  void setObjectCount(size_t objectCount) {
+    d_assert(empty());
+    const size_t chunkBits = (objectCount + kSignatureBits - 1) / kSignatureBits;
+    _chunkBits = chunkBits > 0 ? chunkBits : 1;
+  }
+
+  void clear() {
+    _bits.clear();
+    _ids.clear();
+    _meshCounts.clear();
+    _signatures.clear();
+  }
+
+  void reserve(size_t n) {
+    _bits.reserve(n * kWords);
+    _ids.reserve(n);
+    _meshCounts.reserve(n);
+    _signatures.reserve(n);
+  }
+
+  void push(const MiniHeap *mh) {
+    if (empty())
+      setObjectCount(mh->maxCount());
+    _bits.resize(_bits.size() + kWords);
+    _ids.push_back(GetMiniHeapID(mh));
+    _meshCounts.push_back(mh->meshCount());
+    _signatures.push_back(0);
+    update(size() - 1, mh);
+  }
+
+  // appends a row that doesn't correspond to a live MiniHeap, e.g.
+  // one read back from a heap snapshot
+  void push(const uint64_t *bits, MiniHeapID id, uint32_t meshCount) {
+    for (size_t w = 0; w < kWords; w++) {
+      _bits.push_back(bits[w]);
+    }
+    _ids.push_back(id);
+    _meshCounts.push_back(meshCount);
+    _signatures.push_back(computeSignature(bits));
+  }
+
+  // appends a copy of row off from other, which must use the same
+  // signature chunking
+  void pushRow(const BitmapMirror &other, size_t off) {
+    if (empty())
+      _chunkBits = other._chunkBits;
+    d_assert(_chunkBits == other._chunkBits);
+    const uint64_t *src = other.row(off);
+    for (size_t w = 0; w < kWords; w++) {
+      _bits.push_back(src[w]);
+    }
+    _ids.push_back(other._ids[off]);
+    _meshCounts.push_back(other._meshCounts[off]);
+    _signatures.push_back(other._signatures[off]);
+  }
+
+  // refreshes the bitmap and mesh count of an existing row from mh
+  inline void update(size_t off, const MiniHeap *mh) {
+    d_assert(off < size());
+    const internal::Bitmap::word_t *src = mh->bitmap().bits();
+    uint64_t *dst = row(off);
+    for (size_t w = 0; w < kWords; w++) {
+      dst[w] = src[w].load(std::memory_order_relaxed);
+    }
+    _meshCounts[off] = mh->meshCount();
+    _signatures[off] = computeSignature(dst);
+  }
+
+  inline void swap(size_t a, size_t b) {
+    if (a == b)
+      return;
+    uint64_t *ra = row(a);
+    uint64_t *rb = row(b);
+    for (size_t w = 0; w < kWords; w++) {
+      std::swap(ra[w], rb[w]);
+    }
+    std::swap(_ids[a], _ids[b]);
+    std::swap(_meshCounts[a], _meshCounts[b]);
+    std::swap(_signatures[a], _signatures[b]);
+  }
+
+  void pop() {
+    d_assert(!empty());
+    _bits.resize(_bits.size() - kWords);
+    _ids.pop_back();
+    _meshCounts.pop_back();
+    _signatures.pop_back();
+  }
+
+  // Fisher-Yates, swapping whole rows so that a subsequent walk over
+  // the mirror is still sequential in memory
+  void shuffle(MWC &prng) {
+    if (size() < 2)
+      return;
+    for (size_t i = size() - 1; i > 0; i--) {
+      swap(i, prng.inRange(0, i));
+    }
+  }
+
+  inline uint64_t *row(size_t off) {
+    return &_bits[off * kWords];
+  }
+
+  inline const uint64_t *row(size_t off) const {
+    return &_bits[off * kWords];
+  }
+
+  // the row viewed as a MiniHeap bitmap, for the meshability kernels
+  inline const internal::Bitmap::word_t *bitmap(size_t off) const {
+    return reinterpret_cast<const internal::Bitmap::word_t *>(row(off));
+  }
+
+  inline MiniHeapID id(size_t off) const {
+    return _ids[off];
+  }
+
+  inline uint32_t meshCount(size_t off) const {
+    return _meshCounts[off];
+  }
+
+  inline uint8_t signature(size_t off) const {
+    return _signatures[off];
+  }
+
+  inline uint32_t inUseCount(size_t off) const {
+    const uint64_t *r = row(off);
+    return __builtin_popcountl(r[0]) + __builtin_popcountl(r[1]) + __builtin_popcountl(r[2]) +
+           __builtin_popcountl(r[3]);
+  }
+
+private:
+  uint8_t computeSignature(const uint64_t *bits) const {
+    // the common case: 256 objects, so each 64-bit word is two chunks
+    if (_chunkBits == 32) {
+      uint8_t sig = 0;
+      for (size_t w = 0; w < kWords; w++) {
+        sig |= ((bits[w] & 0xffffffffUL) != 0) << (2 * w);
+        sig |= ((bits[w] >> 32) != 0) << (2 * w + 1);
+      }
+      return sig;
+    }
+
+    uint8_t sig = 0;
+    for (size_t c = 0; c < kSignatureBits; c++) {
+      const size_t start = c * _chunkBits;
+      const size_t end = std::min(start + _chunkBits, kWords * 64);
+      for (size_t i = start; i < end;) {
+        const size_t w = i / 64;
+        const size_t shift = i % 64;
+        const size_t len = std::min(end - i, 64 - shift);
+        const uint64_t mask = len == 64 ? ~0UL : ((1UL << len) - 1) << shift;
+        if (bits[w] & mask) {
+          sig |= 1 << c;
+          break;
+        }
+        i += len;
+      }
+    }
+    return sig;
+  }
+
+  size_t _chunkBits{(kWords * 64) / kSignatureBits};
+  internal::vector<uint64_t> _bits{};
+  internal::vector<MiniHeapID> _ids{};
+  internal::vector<uint32_t> _meshCounts{};
+  internal::vector<uint8_t> _signatures{};
+};
+}  // namespace mesh
+
+#endif  // MESH__BITMAP_MIRROR_H
@@ -66,6 +66,13 @@ static constexpr size_t kMaxMeshesPerIteration = 2500;
 static constexpr size_t kMaxDirtyPageThreshold = 1 << 14;  // 64 MB in pages
 static constexpr size_t kMinDirtyPageThreshold = 32;       // 128 KB in pages
 
+// with the background thread running, dirty pages are instead
+// returned to the OS gradually: each page is purged at most
+// kDirtyDecayTime after it was freed, along a smooth curve sampled
+// at kDirtyDecaySteps epochs (see MeshableArena::decayDirtyPages)
+static constexpr std::chrono::milliseconds kDirtyDecayTime{10000};  // 10 s
+static constexpr size_t kDirtyDecaySteps = 20;
+
 static constexpr uint32_t kSpanClassCount = 256;
 
 static constexpr int kNumBins = 25;  // 16Kb max object size
@@ -82,6 +89,10 @@ static constexpr size_t kMaxMiniheapsPerShuffleVector = 32;
 static constexpr int16_t kMaxShuffleVectorLength = 256;  // sizeof(uint8_t) << 8
 static constexpr bool kEnableShuffleOnInit = SHUFFLE_ON_INIT == 1;
 static constexpr bool kEnableShuffleOnFree = SHUFFLE_ON_FREE == 1;
+// hand out each miniheap's preferred half of its offsets first,
+// alternating halves by miniheap ID, so that sparse spans of a size
+// class tend to stay disjoint (and meshable) pairwise
+static constexpr bool kEnableSteeredPlacement = STEERED_PLACEMENT == 1;
 
 // madvise(DONTDUMP) the heap to make reasonable coredumps
 static constexpr bool kAdviseDump = false;
@@ -91,8 +102,22 @@ static constexpr std::chrono::nanoseconds kMeshPeriodNs{100000000};  // 100 ms
 
 // controls aspects of miniheaps
 static constexpr size_t kMaxMeshes = 256; // 1 per bit
+// maximum number of miniheaps collapsed into a single destination
+// in one mesh pass (including the destination itself)
+static constexpr size_t kMaxMeshGroupSize = 8;
+// bounds on the exhaustive meshers: bitmap comparisons a size class
+// may spend per pass, and how many candidates the approximate maximum
+// matching builds its meshability graph over
+static constexpr size_t kMaxMesherComparisons = 1 << 20;
+static constexpr size_t kMaxMatchingCandidates = 1024;
 
 static constexpr size_t kArenaSize = 8ULL * 1024ULL * 1024ULL * 1024ULL;  // 8 GB
+// the heap grows by chaining further kArenaSize arenas (each backed
+// by its own file) onto the first, up to kMaxArenaCount of them.
+// Their address space is reserved contiguously up front, so finding
+// the arena for a pointer is a division.
+static constexpr size_t kMaxArenaCount = 16;
+static constexpr size_t kMaxHeapSize = kArenaSize * kMaxArenaCount;  // 128 GB
 static constexpr size_t kAltStackSize = 16 * 1024UL;                      // 16k sigaltstacks
 #define SIGQUIESCE (SIGRTMIN + 7)
 #define SIGDUMP (SIGRTMIN + 8)
@@ -105,6 +105,19 @@ void GlobalHeap::freeFor(MiniHeap *mh, void *ptr) {
   }
 }
 
+static_assert(method::kDefaultMesher == 0, "_meshers relies on zero-initialization");
+
+bool GlobalHeap::setMesher(size_t mesher) {
+  if (mesher >= method::MesherCount)
+    return false;
+
+  lock_guard<mutex> lock(_miniheapLock);
+  for (size_t i = 0; i < kNumBins; i++) {
+    _meshers[i] = mesher;
+  }
+  return true;
+}
+
 int GlobalHeap::mallctl(const char *name, void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
   unique_lock<mutex> lock(_miniheapLock);
 
@@ -120,6 +133,31 @@ int GlobalHeap::mallctl(const char *name, void *oldp, size_t *oldlenp, void *new
     auto newVal = reinterpret_cast<size_t *>(newp);
     _meshPeriod = *newVal;
     // resetNextMeshCheck();
+  } else if (strcmp(name, "mesh.mesher") == 0) {
+    // sets the mesher for all size classes, returning the previous
+    // mesher of the smallest one
+    *statp = _meshers[0];
+    if (!newp || newlen < sizeof(size_t))
+      return -1;
+    auto newVal = reinterpret_cast<size_t *>(newp);
+    if (*newVal >= method::MesherCount)
+      return -1;
+    for (size_t i = 0; i < kNumBins; i++) {
+      _meshers[i] = *newVal;
+    }
+  } else if (strncmp(name, "mesh.mesher.", strlen("mesh.mesher.")) == 0) {
+    // per size class: mesh.mesher.<sizeClass>
+    char *end = nullptr;
+    const auto sizeClass = strtoul(name + strlen("mesh.mesher."), &end, 10);
+    if (end == nullptr || *end != '\0' || sizeClass >= kNumBins)
+      return -1;
+    *statp = _meshers[sizeClass];
+    if (!newp || newlen < sizeof(size_t))
+      return -1;
+    auto newVal = reinterpret_cast<size_t *>(newp);
+    if (*newVal >= method::MesherCount)
+      return -1;
+    _meshers[sizeClass] = *newVal;
   } else if (strcmp(name, "mesh.scavenge") == 0) {
     lock.unlock();
     scavenge(true);
@@ -189,7 +227,7 @@ void GlobalHeap::meshAllSizeClasses() {
   auto meshFound = function<void(std::pair<MiniHeap *, MiniHeap *> &&)>(
       // std::allocator_arg, internal::allocator,
       [&](std::pair<MiniHeap *, MiniHeap *> &&miniheaps) {
-        if (std::get<0>(miniheaps)->isMeshingCandidate() && std::get<0>(miniheaps)->isMeshingCandidate())
+        if (std::get<0>(miniheaps)->isMeshingCandidate() && std::get<1>(miniheaps)->isMeshingCandidate())
           mergeSets.push_back(std::move(miniheaps));
       });
 
@@ -198,7 +236,7 @@ void GlobalHeap::meshAllSizeClasses() {
     // method::greedySplitting(_prng, _littleheaps[i], meshFound);
     // method::simpleGreedySplitting(_prng, _littleheaps[i], meshFound);
     partialCount += _littleheaps[i].partialSize();
-    method::shiftedSplitting(_fastPrng, _littleheaps[i], meshFound);
+    method::meshWith(method::mesherEntry(_meshers[i]).mesher, _fastPrng, _littleheaps[i], meshFound);
   }
 
   // more than ~ 1 MB saved
@@ -212,19 +250,30 @@ void GlobalHeap::meshAllSizeClasses() {
 
   _stats.meshCount += mergeSets.size();
 
-  for (auto &mergeSet : mergeSets) {
-    // merge _into_ the one with a larger mesh count, potentially
-    // swapping the order of the pair
-    const auto aCount = std::get<0>(mergeSet)->meshCount();
+  // merge _into_ the one with a larger mesh count, potentially
+  // swapping the order of the pair.  Consecutive pairs sharing a
+  // destination form a multi-way group: the destination's chain grows
+  // with each member, and it must never be swapped out.
+  size_t last = 0;
+  MiniHeap *groupDst = nullptr;
+  size_t groupCount = 0;
+  for (size_t i = 0; i < mergeSets.size(); i++) {
+    auto mergeSet = mergeSets[i];
+    const bool inGroup = std::get<0>(mergeSet) == groupDst;
+    const auto aCount = inGroup ? groupCount : std::get<0>(mergeSet)->meshCount();
     const auto bCount = std::get<1>(mergeSet)->meshCount();
     if (aCount + bCount > kMaxMeshes) {
       continue;
-    } else if (aCount < bCount) {
+    } else if (!inGroup && aCount < bCount) {
       mergeSet = std::pair<MiniHeap *, MiniHeap *>(std::get<1>(mergeSet), std::get<0>(mergeSet));
     }
-
-    meshLocked(std::get<0>(mergeSet), std::get<1>(mergeSet));
+    groupDst = std::get<0>(mergeSet);
+    groupCount = aCount + bCount;
+    mergeSets[last++] = mergeSet;
   }
+  mergeSets.erase(mergeSets.begin() + last, mergeSets.end());
+
+  meshSetsLocked(mergeSets);
 
   Super::scavenge(false);
 
@@ -234,6 +283,55 @@ void GlobalHeap::meshAllSizeClasses() {
   // debug("mesh took %f, found %zu", duration.count(), mergeSets.size());
 }
 
+void GlobalHeap::meshSetsLocked(internal::vector<std::pair<MiniHeap *, MiniHeap *>> &mergeSets) {
+  if (mergeSets.empty()) {
+    return;
+  }
+
+  // marks all source spans read-only
+  internal::vector<Span> removeSpans;
+  for (auto &mergeSet : mergeSets) {
+    std::get<1>(mergeSet)->forEachMeshed([&](const MiniHeap *mh) {
+      removeSpans.push_back(mh->span());
+      return false;
+    });
+  }
+  Super::beginMesh(removeSpans);
+
+  internal::vector<SpanMesh> meshes;
+  for (auto &mergeSet : mergeSets) {
+    MiniHeap *dst = std::get<0>(mergeSet);
+    MiniHeap *src = std::get<1>(mergeSet);
+
+    // objects of a page or more are remapped page by page: only the
+    // pages of src's chain that hold live objects need to alias dst
+    const uint64_t pageMask = src->meshesByPage() ? src->occupiedPageMask() : 0;
+
+    // does the copying of objects and updating of span metadata
+    dst->consume(arenaBegin(), src);
+    d_assert(src->isMeshed());
+
+    src->forEachMeshed([&](const MiniHeap *mh) {
+      d_assert(mh->isMeshed());
+      meshes.emplace_back(dst->span(), mh->span(), pageMask);
+      return false;
+    });
+  }
+
+  // frees physical memory + re-marks srcSpans as read/write
+  Super::finalizeMesh(meshes);
+
+  for (auto &mergeSet : mergeSets) {
+    MiniHeap *dst = std::get<0>(mergeSet);
+    MiniHeap *src = std::get<1>(mergeSet);
+
+    // make sure we adjust what bin the destination is in -- it might
+    // now be full and not a candidate for meshing
+    _littleheaps[dst->sizeClass()].postFree(dst, dst->inUseCount());
+    untrackMiniheapLocked(src);
+  }
+}
+
 void GlobalHeap::dumpStats(int level, bool beDetailed) const {
   if (level < 1)
     return;
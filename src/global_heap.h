@@ -57,6 +57,19 @@ public:
     }
   }
 
+  // copies an occupancy record for every miniheap into records,
+  // holding the global lock only for the copy itself
+  inline void snapshot(internal::vector<snapshot::Record> &records) const {
+    records.clear();
+
+    lock_guard<mutex> lock(_miniheapLock);
+
+    records.reserve(_miniheapCount);
+    for (size_t i = 0; i < kNumBins; i++) {
+      _littleheaps[i].snapshot(records);
+    }
+  }
+
   inline void flushAllBins() {
     for (size_t sizeClass = 0; sizeClass < kNumBins; sizeClass++) {
       flushBinLocked(sizeClass);
@@ -69,6 +82,38 @@ public:
     Super::scavenge(force);
   }
 
+  void setDirtyDecay(bool enabled) {
+    lock_guard<mutex> lock(_miniheapLock);
+
+    Super::setDirtyDecay(enabled);
+  }
+
+  // one step of dirty page decay; run periodically by the runtime's
+  // background thread
+  void decayDirtyPages() {
+    lock_guard<mutex> lock(_miniheapLock);
+
+    Super::decayDirtyPages();
+  }
+
+  void setAsyncPunch(int notifyFd) {
+    lock_guard<mutex> lock(_miniheapLock);
+
+    Super::setAsyncPunch(notifyFd);
+  }
+
+  // punches the queued holes in the arena file; the heap lock is
+  // only held to take the queue
+  void drainPunches() {
+    {
+      lock_guard<mutex> lock(_miniheapLock);
+      if (!Super::beginPunches())
+        return;
+    }
+
+    Super::finishPunches();
+  }
+
   void dumpStats(int level, bool beDetailed) const;
 
   // must be called with exclusive _mhRWLock held
@@ -300,6 +345,10 @@ public:
     _meshPeriodNs = period;
   }
 
+  // selects the mesher (a method::MesherId) used for every size
+  // class.  Returns false if mesher is unknown.
+  bool setMesher(size_t mesher);
+
   void lock() {
     _miniheapLock.lock();
     // internal::Heap().lock();
@@ -313,32 +362,9 @@ public:
   // PUBLIC ONLY FOR TESTING
   // after call to meshLocked() completes src is a nullptr
   void meshLocked(MiniHeap *dst, MiniHeap *&src) {
-    const size_t dstSpanSize = dst->spanSize();
-    const auto dstSpanStart = reinterpret_cast<void *>(dst->getSpanStart(arenaBegin()));
-
-    src->forEachMeshed([&](const MiniHeap *mh) {
-      // marks srcSpans read-only
-      const auto srcSpan = reinterpret_cast<void *>(mh->getSpanStart(arenaBegin()));
-      Super::beginMesh(dstSpanStart, srcSpan, dstSpanSize);
-      return false;
-    });
-
-    // does the copying of objects and updating of span metadata
-    dst->consume(arenaBegin(), src);
-    d_assert(src->isMeshed());
-
-    src->forEachMeshed([&](const MiniHeap *mh) {
-      d_assert(mh->isMeshed());
-      const auto srcSpan = reinterpret_cast<void *>(mh->getSpanStart(arenaBegin()));
-      // frees physical memory + re-marks srcSpans as read/write
-      Super::finalizeMesh(dstSpanStart, srcSpan, dstSpanSize);
-      return false;
-    });
-
-    // make sure we adjust what bin the destination is in -- it might
-    // now be full and not a candidate for meshing
-    _littleheaps[dst->sizeClass()].postFree(dst, dst->inUseCount());
-    untrackMiniheapLocked(src);
+    internal::vector<std::pair<MiniHeap *, MiniHeap *>> mergeSets;
+    mergeSets.emplace_back(dst, src);
+    meshSetsLocked(mergeSets);
   }
 
   inline void ATTRIBUTE_ALWAYS_INLINE maybeMesh() {
@@ -396,6 +422,9 @@ public:
 private:
   // check for meshes in all size classes -- must be called LOCKED
   void meshAllSizeClasses();
+  // meshes each (dst, src) pair.  The arena syscalls for the whole
+  // batch are issued together so that adjacent spans share them.
+  void meshSetsLocked(internal::vector<std::pair<MiniHeap *, MiniHeap *>> &mergeSets);
 
   const size_t _maxObjectSize;
   atomic_size_t _lastMeshEffective{0};
@@ -407,6 +436,9 @@ private:
   MWC _fastPrng;
 
   BinnedTracker _littleheaps[kNumBins];
+  // the method::MesherId each size class searches for meshes with
+  // (zero-initialized to method::kDefaultMesher)
+  size_t _meshers[kNumBins] = {};
 
   mutable mutex _miniheapLock{};
 
@@ -0,0 +1,116 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil -*-
+// Copyright 2018 Bobby Powers
+
+#pragma once
+#ifndef MESH__HEAP_SNAPSHOT_H
+#define MESH__HEAP_SNAPSHOT_H
+
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "internal.h"
+
+// A compact binary snapshot of the heap's occupancy, written in
+// response to SIGDUMP so that meshing can be replayed offline (see
+// meshing-benchmark).  The file is a Header followed by
+// header.recordCount fixed-size Records, in host byte order.
+
+namespace mesh {
+namespace snapshot {
+
+static constexpr uint32_t kMagic = 0x504e534d;  // "MSNP"
+static constexpr uint32_t kVersion = 1;
+
+enum RecordFlags : uint16_t {
+  Attached = 1 << 0,
+  Meshed = 1 << 1,  // meshed into another miniheap's span
+};
+
+struct Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t recordSize;
+  uint32_t recordCount;
+};
+
+// one per MiniHeap, including the members of mesh chains
+struct Record {
+  uint64_t bitmap[4];
+  uint32_t id;         // MiniHeapID
+  uint32_t chainHead;  // MiniHeapID of the chain this belongs to (== id if not meshed away)
+  int16_t sizeClass;
+  uint16_t objectCount;
+  uint16_t meshCount;  // length of the mesh chain headed by this miniheap
+  uint16_t flags;
+};
+
+static_assert(sizeof(Header) == 16, "snapshot header must be packed");
+static_assert(sizeof(Record) == 48, "snapshot records must be packed");
+
+// writes a complete snapshot to fd, retrying on partial writes.
+// Returns false (with errno set) on failure.
+inline bool write(int fd, const Record *records, size_t count) {
+  Header header{kMagic, kVersion, sizeof(Record), static_cast<uint32_t>(count)};
+
+  struct iovec iov[2];
+  iov[0].iov_base = &header;
+  iov[0].iov_len = sizeof(header);
+  iov[1].iov_base = const_cast<Record *>(records);
+  iov[1].iov_len = count * sizeof(Record);
+
+  struct iovec *pending = iov;
+  int pendingCount = 2;
+  while (pendingCount > 0) {
+    const ssize_t written = ::writev(fd, pending, pendingCount);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+
+    size_t remaining = written;
+    while (pendingCount > 0 && remaining >= pending->iov_len) {
+      remaining -= pending->iov_len;
+      pending++;
+      pendingCount--;
+    }
+    if (pendingCount > 0) {
+      pending->iov_base = reinterpret_cast<char *>(pending->iov_base) + remaining;
+      pending->iov_len -= remaining;
+    }
+  }
+
+  return true;
+}
+
+// reads a snapshot written by write() from fd into records.  Returns
+// false if fd doesn't hold a snapshot of this version.
+inline bool read(int fd, internal::vector<Record> &records) {
+  const auto readFully = [fd](void *buf, size_t len) {
+    char *p = reinterpret_cast<char *>(buf);
+    while (len > 0) {
+      const ssize_t n = ::read(fd, p, len);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      p += n;
+      len -= n;
+    }
+    return true;
+  };
+
+  Header header{};
+  if (!readFully(&header, sizeof(header)))
+    return false;
+  if (header.magic != kMagic || header.version != kVersion || header.recordSize != sizeof(Record))
+    return false;
+
+  records.resize(header.recordCount);
+  return readFully(records.data(), header.recordCount * sizeof(Record));
+}
+}  // namespace snapshot
+}  // namespace mesh
+
+#endif  // MESH__HEAP_SNAPSHOT_H
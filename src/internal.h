@@ -11,6 +11,7 @@
 #endif
 
 #include <atomic>
+#include <set>
 #include <unordered_set>
 
 #include <signal.h>
@@ -115,8 +116,13 @@ struct Span {
     return std::min(length, kSpanClassCount) - 1;
   }
 
+  // the span's distance from the start of the arena, in bytes
+  size_t byteOffset() const {
+    return static_cast<size_t>(offset) * kPageSize;
+  }
+
   size_t byteLength() const {
-    return length * kPageSize;
+    return static_cast<size_t>(length) * kPageSize;
   }
 
   inline bool operator==(const Span &rhs) {
@@ -190,6 +196,9 @@ using unordered_set = std::unordered_set<K, hash<K>, equal_to<K>, STLAllocator<K
 template <typename K, typename V>
 using map = std::map<K, V, std::less<K>, STLAllocator<pair<const K, V>, Heap>>;
 
+template <typename K>
+using set = std::set<K, std::less<K>, STLAllocator<K, Heap>>;
+
 typedef std::basic_string<char, std::char_traits<char>, STLAllocator<char, Heap>> string;
 
 template <typename T>
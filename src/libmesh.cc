@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 
+#include "meshing.h"
 #include "runtime.h"
 #include "thread_local_heap.h"
 
@@ -24,6 +25,25 @@ static __attribute__((constructor)) void libmesh_init() {
     runtime().setMeshPeriodNs(std::chrono::milliseconds{period});
   }
 
+  // one of the names registered in meshing.h, e.g. "maxmatch"
+  char *mesherStr = getenv("MESH_MESHER");
+  if (mesherStr) {
+    const auto mesher = method::mesherByName(mesherStr);
+    if (mesher < 0 || !runtime().heap().setMesher(mesher)) {
+      debug("MESH_MESHER: unknown mesher '%s'", mesherStr);
+    }
+  }
+
+  // dirty page decay only runs on the background thread
+  char *decayStr = getenv("MESH_DIRTY_DECAY_MS");
+  if (decayStr) {
+    long decay = strtol(decayStr, nullptr, 10);
+    if (decay < 0) {
+      decay = 0;
+    }
+    runtime().setDirtyDecayMs(std::chrono::milliseconds{decay});
+  }
+
   char *bgThread = getenv("MESH_BACKGROUND_THREAD");
   if (!bgThread)
     return;
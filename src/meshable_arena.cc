@@ -40,25 +40,15 @@ MeshableArena::MeshableArena() : SuperHeap() {
   d_assert(arenaInstance == nullptr);
   arenaInstance = this;
 
-  int fd = -1;
-  if (kMeshingEnabled) {
-    fd = openSpanFile(kArenaSize);
-    if (fd < 0) {
-      debug("mesh: opening arena file failed.\n");
-      abort();
-    }
-  }
-  _fd = fd;
-  _arenaBegin = SuperHeap::map(kArenaSize, kMapShared, fd);
-  _mhIndex = reinterpret_cast<atomic<MiniHeapID> *>(SuperHeap::malloc(indexSize()));
+  // reserve address space for every arena we might chain, and back
+  // the first one
+  _arenaBegin = mmap(nullptr, kMaxHeapSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  hard_assert(_arenaBegin != MAP_FAILED);
+  addArena();
 
-  hard_assert(_arenaBegin != nullptr);
+  _mhIndex = reinterpret_cast<atomic<MiniHeapID> *>(SuperHeap::malloc(indexSize()));
   hard_assert(_mhIndex != nullptr);
 
-  if (kAdviseDump) {
-    madvise(_arenaBegin, kArenaSize, MADV_DONTDUMP);
-  }
-
   // debug("MeshableArena(%p): fd:%4d\t%p-%p\n", this, fd, _arenaBegin, arenaEnd());
 
   // TODO: move this to runtime
@@ -98,84 +88,181 @@ char *MeshableArena::openSpanDir(int pid) {
   return nullptr;
 }
 
+// backs the next kArenaSize of reserved address space with a file
+// of its own
+void MeshableArena::addArena() {
+  hard_assert_msg(_arenaCount < kMaxArenaCount, "mesh: all %zu arenas exhausted", kMaxArenaCount);
+
+  int fd = -1;
+  if (kMeshingEnabled) {
+    fd = openSpanFile(kArenaSize);
+    if (fd < 0) {
+      debug("mesh: opening arena file failed.\n");
+      abort();
+    }
+  }
+
+  void *begin = reinterpret_cast<char *>(_arenaBegin) + _arenaCount * kArenaSize;
+  void *ptr = mmap(begin, kArenaSize, HL_MMAP_PROTECTION_MASK, kMapShared | MAP_FIXED, fd, 0);
+  hard_assert_msg(ptr != MAP_FAILED, "mesh: mapping arena failed: %d", errno);
+
+  if (kAdviseDump) {
+    madvise(begin, kArenaSize, MADV_DONTDUMP);
+  }
+
+  _fds[_arenaCount++] = fd;
+}
+
 void MeshableArena::expandArena(Length minPagesAdded) {
-  const size_t pageCount = std::max(minPagesAdded, kMinArenaExpansion);
+  hard_assert(minPagesAdded <= kArenaPageCount);
+
+  // spans can't straddle two arenas: if the request doesn't fit in
+  // what is left of the last one, file the leftovers and chain a new
+  // arena
+  Offset capacity = _arenaCount * kArenaPageCount;
+  if (_end + minPagesAdded > capacity) {
+    const Span leftover(_end, capacity - _end);
+    _end = capacity;
+    if (!leftover.empty()) {
+      insertFree(_clean, _cleanBitmap, leftover);
+    }
+    addArena();
+    capacity += kArenaPageCount;
+  }
+
+  const size_t pageCount = std::min<size_t>(std::max(minPagesAdded, kMinArenaExpansion), capacity - _end);
 
   Span expansion(_end, pageCount);
   _end += pageCount;
 
-  _clean[expansion.spanClass()].push_back(expansion);
+  insertFree(_clean, _cleanBitmap, expansion);
 }
 
-bool MeshableArena::findPagesInner(internal::vector<Span> freeSpans[kSpanClassCount], const size_t i,
-                                   const Length pageCount, Span &result) {
-  internal::vector<Span> &spanList = freeSpans[i];
-  if (spanList.empty())
-    return false;
-
-  size_t oldLen = spanList.size();
+// the first page in [off, end) whose bit is set (if set is true) or
+// clear (otherwise), or end if there is none
+static size_t nextPage(const uint64_t *bits, size_t off, const size_t end, const bool set) {
+  while (off < end) {
+    const uint64_t word = set ? bits[off / 64] : ~bits[off / 64];
+    const uint64_t masked = word & (~0UL << (off % 64));
+    if (masked != 0) {
+      const size_t found = (off & ~63UL) + __builtin_ctzl(masked);
+      return found < end ? found : end;
+    }
+    off = (off & ~63UL) + 64;
+  }
+  return end;
+}
 
-  if (i == kSpanClassCount - 1 && spanList.back().length < pageCount) {
-    // the final span class contains (and is the only class to
-    // contain) variable-size spans, so we need to make sure we
-    // search through all candidates in this case.
-    for (size_t j = 0; j < spanList.size() - 1; j++) {
-      if (spanList[j].length >= pageCount) {
-        std::swap(spanList[j], spanList.back());
-        break;
-      }
+// the start of the run of set pages that ends just before off (off
+// itself if page off - 1 is clear)
+static size_t runStart(const uint64_t *bits, size_t off) {
+  while (off > 0) {
+    const size_t last = off - 1;
+    const uint64_t clear = ~bits[last / 64] & (~0UL >> (63 - last % 64));
+    if (clear != 0) {
+      return (last & ~63UL) + 64 - __builtin_clzl(clear);
     }
+    off = last & ~63UL;
+  }
+  return 0;
+}
 
-    // check that we found something in the above loop. this would be
-    // our last loop iteration anyway
-    if (spanList.back().length < pageCount) {
-      return false;
+static void setPages(uint64_t *bits, const Span &span, const bool set) {
+  size_t off = span.offset;
+  const size_t end = span.offset + span.length;
+  while (off < end) {
+    const size_t wordEnd = std::min((off & ~63UL) + 64, end);
+    const size_t len = wordEnd - off;
+    const uint64_t mask = (len == 64 ? ~0UL : ((1UL << len) - 1)) << (off % 64);
+    if (set) {
+      bits[off / 64] |= mask;
+    } else {
+      bits[off / 64] &= ~mask;
     }
+    off = wordEnd;
   }
+}
 
-  Span span = spanList.back();
-  spanList.pop_back();
+// files span as free in spans, and marks its pages in the matching
+// page-state bitmap.  span is merged with the free spans on either
+// side of it, so each run of free pages within an arena is always a
+// single entry -- the neighbours' extents come straight from the
+// bitmap.
+void MeshableArena::insertFree(SpanIndex &spans, internal::RelaxedBitmap &pages, const Span &span) {
+  uint64_t *bits = pages.mut_bits();
+  const size_t spanEnd = span.offset + span.length;
+  d_assert(nextPage(bits, span.offset, spanEnd, true) == spanEnd);
+  d_assert(arenaStart(span.offset) == arenaStart(spanEnd - 1));
+
+  const size_t firstPage = arenaStart(span.offset);
+  const size_t begin = std::max(runStart(bits, span.offset), firstPage);
+  const size_t end = nextPage(bits, spanEnd, std::min<size_t>(_end, firstPage + kArenaPageCount), false);
+  if (begin < span.offset) {
+    spans.remove(Span(begin, span.offset - begin));
+  }
+  if (end > spanEnd) {
+    spans.remove(Span(spanEnd, end - spanEnd));
+  }
+
+  setPages(bits, span, true);
+  spans.push(Span(begin, end - begin));
+}
 
-#ifndef NDEBUG
-  d_assert_msg(oldLen == spanList.size() + 1, "pageCount:%zu,%zu -- %zu/%zu", pageCount, i, oldLen, spanList.size());
-  for (size_t j = 0; j < spanList.size(); j++) {
-    d_assert(spanList[j] != span);
-  }
-#endif
+// the first offset in span that is aligned to pageAlignment pages
+// in the address space
+Offset MeshableArena::alignedOffset(const Span &span, const Length pageAlignment) const {
+  const size_t page = ptrvalFromOffset(span.offset) / kPageSize;
+  const size_t misalignment = page % pageAlignment;
+  return span.offset + (misalignment == 0 ? 0 : pageAlignment - misalignment);
+}
 
-  // this invariant should be maintained
-  d_assert(span.length >= i + 1);
-  d_assert(span.length >= pageCount);
+// hands out pageCount aligned pages from span, returning the pages
+// before and after them to spans
+Span MeshableArena::carve(Span span, const Length pageCount, const Length pageAlignment, SpanIndex &spans) {
+  const Offset off = alignedOffset(span, pageAlignment);
+  d_assert(off + pageCount <= span.offset + span.length);
 
-  // put the part we don't need back in the reuse pile
-  Span rest = span.splitAfter(pageCount);
+  Span result = span.splitAfter(off - span.offset);
+  if (!span.empty()) {
+    spans.push(span);
+  }
+  Span rest = result.splitAfter(pageCount);
   if (!rest.empty()) {
-    freeSpans[rest.spanClass()].push_back(rest);
+    spans.push(rest);
   }
-  d_assert(span.length == pageCount);
 
-  result = span;
-  return true;
+  d_assert(result.length == pageCount);
+  d_assert(isAligned(result, pageAlignment));
+  return result;
 }
 
-bool MeshableArena::findPages(const Length pageCount, Span &result, internal::PageType &type) {
+bool MeshableArena::findPages(const Length pageCount, const Length pageAlignment, Span &result,
+                              internal::PageType &type) {
+  // any span this long has an aligned run of pageCount pages, so
+  // aligned requests never need to over-reserve and split afterwards
+  const Length minLength = pageCount + pageAlignment - 1;
+  Span span(0, 0);
+
   // Search through all dirty spans first.  We don't worry about
   // fragmenting dirty pages, as being able to reuse dirty pages means
   // we don't increase RSS.
-  for (size_t i = Span(0, pageCount).spanClass(); i < kSpanClassCount; i++) {
-    if (findPagesInner(_dirty, i, pageCount, result)) {
-      type = internal::PageType::Dirty;
-      return true;
-    }
+  if (_dirty.popFit(minLength, span)) {
+    result = carve(span, pageCount, pageAlignment, _dirty);
+    setPages(_dirtyBitmap.mut_bits(), result, false);
+    type = internal::PageType::Dirty;
+    return true;
   }
 
   // if no dirty pages are avaiable, search clean pages.  An allocated
   // clean page (once it is written to) means an increased RSS.
-  for (size_t i = Span(0, pageCount).spanClass(); i < kSpanClassCount; i++) {
-    if (findPagesInner(_clean, i, pageCount, result)) {
-      type = internal::PageType::Clean;
-      return true;
+  if (_clean.popFit(minLength, span)) {
+    result = carve(span, pageCount, pageAlignment, _clean);
+    setPages(_cleanBitmap.mut_bits(), result, false);
+    if (_punchNotifyFd >= 0) {
+      cancelPunches(result);
     }
+    type = internal::PageType::Clean;
+    return true;
   }
 
   return false;
@@ -183,79 +270,59 @@ bool MeshableArena::findPages(const Length pageCount, Span &result, internal::Pa
 
 Span MeshableArena::reservePages(const Length pageCount, const Length pageAlignment) {
   d_assert(pageCount >= 1);
+  d_assert(pageAlignment >= 1);
 
   internal::PageType flags(internal::PageType::Unknown);
   Span result(0, 0);
-  auto ok = findPages(pageCount, result, flags);
+  auto ok = findPages(pageCount, pageAlignment, result, flags);
   if (!ok) {
-    expandArena(pageCount);
-    ok = findPages(pageCount, result, flags);
+    expandArena(pageCount + pageAlignment - 1);
+    ok = findPages(pageCount, pageAlignment, result, flags);
     hard_assert(ok);
   }
 
   d_assert(!result.empty());
   d_assert(flags != internal::PageType::Unknown);
 
-  if (unlikely(pageAlignment > 1 && ((ptrvalFromOffset(result.offset) / kPageSize) % pageAlignment != 0))) {
-    freeSpan(result, flags);
-    // recurse once, asking for enough extra space that we are sure to
-    // be able to find an aligned offset of pageCount pages within.
-    result = reservePages(pageCount + 2 * pageAlignment, 1);
-
-    const size_t alignment = pageAlignment * kPageSize;
-    const uintptr_t alignedPtr = (ptrvalFromOffset(result.offset) + alignment - 1) & ~(alignment - 1);
-    const auto alignedOff = offsetFor(reinterpret_cast<void *>(alignedPtr));
-    d_assert(alignedOff >= result.offset);
-    d_assert(alignedOff < result.offset + result.length);
-    const auto unwantedPageCount = alignedOff - result.offset;
-    auto alignedResult = result.splitAfter(unwantedPageCount);
-    d_assert(alignedResult.offset == alignedOff);
-    freeSpan(result, flags);
-    const auto excess = alignedResult.splitAfter(pageCount);
-    freeSpan(excess, flags);
-    result = alignedResult;
-  }
-
   return result;
 }
 
-template <typename Func>
-static void forEachFree(const internal::vector<Span> freeSpans[kSpanClassCount], const Func func) {
-  for (size_t i = 0; i < kSpanClassCount; i++) {
-    if (freeSpans[i].empty())
-      continue;
+// sorts spans by offset and merges adjacent ones, so that callers can
+// issue a single syscall per contiguous run of pages.
+static void coalesceSpans(internal::vector<Span> &spans) {
+  if (spans.size() < 2) {
+    return;
+  }
+
+  std::sort(spans.begin(), spans.end(), [](const Span &a, const Span &b) { return a.offset < b.offset; });
 
-    for (size_t j = 0; j < freeSpans[i].size(); j++) {
-      auto span = freeSpans[i][j];
-      func(span);
+  size_t last = 0;
+  for (size_t i = 1; i < spans.size(); i++) {
+    d_assert(spans[last].offset + spans[last].length <= spans[i].offset);
+    if (spans[last].offset + spans[last].length == spans[i].offset) {
+      spans[last].length += spans[i].length;
+    } else {
+      spans[++last] = spans[i];
     }
   }
+
+  spans.erase(spans.begin() + last + 1, spans.end());
 }
 
-internal::RelaxedBitmap MeshableArena::allocatedBitmap(bool includeDirty) const {
+internal::RelaxedBitmap MeshableArena::allocatedBitmap() const {
   internal::RelaxedBitmap bitmap(_end);
 
-  // we can build up a bitmap of in-use pages here by looking at the
-  // arena start and end addresses (to compute the number of
-  // bits/pages), set all bits to 1, then iterate through our _clean
-  // and _dirty lists unsetting pages that aren't in use.
-
+  // every page below _end is in use, except for the free pages
+  // tracked in _cleanBitmap and _dirtyBitmap
   bitmap.setAll(_end);
 
-  auto unmarkPages = [&](const Span &span) {
-    for (size_t k = 0; k < span.length; k++) {
-#ifdef NDEBUG
-      if (!bitmap.isSet(span.offset + k)) {
-        debug("arena: bit %zu already unset 1 (%zu/%zu)\n", k, span.offset, span.length);
-      }
-#endif
-      bitmap.unset(span.offset + k);
-    }
-  };
-
-  if (includeDirty)
-    forEachFree(_dirty, unmarkPages);
-  forEachFree(_clean, unmarkPages);
+  uint64_t *bits = bitmap.mut_bits();
+  const uint64_t *cleanBits = _cleanBitmap.bits();
+  const uint64_t *dirtyBits = _dirtyBitmap.bits();
+  for (size_t i = 0; i < bitmap.byteCount() / sizeof(size_t); i++) {
+    d_assert((cleanBits[i] & dirtyBits[i]) == 0);
+    bits[i] &= ~(cleanBits[i] | dirtyBits[i]);
+  }
 
   return bitmap;
 }
@@ -306,116 +373,163 @@ void MeshableArena::free(void *ptr, size_t sz, internal::PageType type) {
   freeSpan(span, type);
 }
 
+// moves every dirty span to the clean index, returning them in dirty
+void MeshableArena::cleanDirtySpans(internal::vector<Span> &dirty) {
+  _dirty.forEach([&](const Span &span) { dirty.push_back(span); });
+  _dirty.clear();
+  _dirtyPageCount = 0;
+
+  // nothing is left to decay
+  _dirtyLog.clear();
+  _dirtyLogHead = 0;
+  std::fill(_decayFreed, _decayFreed + kDirtyDecaySteps, 0);
+
+  for (auto const &span : dirty) {
+    setPages(_dirtyBitmap.mut_bits(), span, false);
+    insertFree(_clean, _cleanBitmap, span);
+  }
+}
+
 void MeshableArena::partialScavenge() {
-  forEachFree(_dirty, [&](const Span &span) {
-    auto ptr = ptrFromOffset(span.offset);
-    auto sz = span.byteLength();
-    madvise(ptr, sz, MADV_DONTNEED);
-    freePhys(ptr, sz);
-    // don't coalesce, just add to clean
-    _clean[span.spanClass()].push_back(span);
-  });
+  internal::vector<Span> dirty;
+  cleanDirtySpans(dirty);
+  releaseSpans(dirty);
+}
 
-  for (size_t i = 0; i < kSpanClassCount; i++) {
-    _dirty[i].clear();
+void MeshableArena::setDirtyDecay(bool enabled) {
+  _dirtyDecayEnabled = enabled;
+  if (!enabled) {
+    _dirtyLog.clear();
+    _dirtyLogHead = 0;
+    std::fill(_decayFreed, _decayFreed + kDirtyDecaySteps, 0);
   }
+}
 
-  _dirtyPageCount = 0;
+// removes the pages of span from the dirty index (span must lie
+// inside a single dirty run), filing the pieces of the run on either
+// side of it back, and appends span to taken
+void MeshableArena::takeDirtyPages(const Span &span, internal::vector<Span> &taken) {
+  uint64_t *bits = _dirtyBitmap.mut_bits();
+  const size_t spanEnd = span.offset + span.length;
+
+  const size_t firstPage = arenaStart(span.offset);
+  const size_t begin = std::max(runStart(bits, span.offset), firstPage);
+  const size_t end = nextPage(bits, span.offset, std::min<size_t>(_end, firstPage + kArenaPageCount), false);
+  d_assert(end >= spanEnd);
+
+  _dirty.remove(Span(begin, end - begin));
+  if (begin < span.offset) {
+    _dirty.push(Span(begin, span.offset - begin));
+  }
+  if (end > spanEnd) {
+    _dirty.push(Span(spanEnd, end - spanEnd));
+  }
+
+  setPages(bits, span, false);
+  _dirtyPageCount -= span.length;
+  taken.push_back(span);
 }
 
-void MeshableArena::scavenge(bool force) {
-  if (!force && _dirtyPageCount < kMinDirtyPageThreshold)
+// the number of dirty pages we are still willing to hold: pages
+// freed k epochs ago count for smootherstep(1 - k/kDirtyDecaySteps),
+// so recently freed pages are kept for cheap reuse while older ones
+// are released at a steadily increasing rate
+size_t MeshableArena::dirtyDecayLimit() const {
+  double limit = 0;
+  for (size_t k = 0; k < kDirtyDecaySteps; k++) {
+    const double x = 1.0 - static_cast<double>(k) / kDirtyDecaySteps;
+    const double h = x * x * x * (x * (x * 6 - 15) + 10);
+    limit += h * _decayFreed[(_decayEpoch - k) % kDirtyDecaySteps];
+  }
+  return static_cast<size_t>(limit);
+}
+
+void MeshableArena::decayDirtyPages() {
+  if (!_dirtyDecayEnabled) {
     return;
+  }
 
-  // the inverse of the allocated bitmap is all of the spans in _clear
-  // (since we just MADV_DONTNEED'ed everything in dirty)
-  auto bitmap = allocatedBitmap(false);
-  bitmap.invert();
+  _decayEpoch++;
+  // the slot being reused held frees from kDirtyDecaySteps epochs
+  // ago, which have fully decayed
+  _decayFreed[_decayEpoch % kDirtyDecaySteps] = 0;
 
-  auto markPages = [&](const Span &span) {
-    for (size_t k = 0; k < span.length; k++) {
-#ifndef NDEBUG
-      if (bitmap.isSet(span.offset + k)) {
-        debug("arena: bit %zu already set (%zu/%zu) %zu\n", k, span.offset, span.length, bitmap.bitCount());
-      }
-#endif
-      bitmap.tryToSet(span.offset + k);
-    }
-  };
+  const size_t limit = dirtyDecayLimit();
 
-  // first, untrack the spans in the meshed bitmap and mark them in
-  // the (method-local) unallocated bitmap
-  std::for_each(_toReset.begin(), _toReset.end(), [&](Span span) {
-    untrackMeshed(span);
-    markPages(span);
-    resetSpanMapping(span);
-  });
+  internal::vector<Span> purged;
+  while (_dirtyLogHead < _dirtyLog.size()) {
+    const DirtyFree &record = _dirtyLog[_dirtyLogHead];
+    const bool expired = record.epoch + kDirtyDecaySteps <= _decayEpoch;
+    if (!expired && _dirtyPageCount <= limit) {
+      break;
+    }
 
-  // now that we've finally reset to identity all delayed-reset
-  // mappings, empty the list
-  _toReset.clear();
+    // purge whatever part of the freed span is still dirty
+    const uint64_t *bits = _dirtyBitmap.bits();
+    const size_t end = record.span.offset + record.span.length;
+    size_t off = nextPage(bits, record.span.offset, end, true);
+    while (off < end) {
+      const size_t runEnd = nextPage(bits, off, end, false);
+      takeDirtyPages(Span(off, runEnd - off), purged);
+      off = nextPage(bits, runEnd, end, true);
+    }
 
-  _meshedPageCount = _meshedBitmap.inUseCount();
-  if (_meshedPageCount > _meshedPageCountHWM) {
-    _meshedPageCountHWM = _meshedPageCount;
-    // TODO: find rss at peak
+    _dirtyLogHead++;
   }
 
-  forEachFree(_dirty, [&](const Span &span) {
-    auto ptr = ptrFromOffset(span.offset);
-    auto sz = span.byteLength();
-    madvise(ptr, sz, MADV_DONTNEED);
-    freePhys(ptr, sz);
-    markPages(span);
-  });
+  if (_dirtyLogHead == _dirtyLog.size()) {
+    _dirtyLog.clear();
+    _dirtyLogHead = 0;
+  } else if (_dirtyLogHead * 2 >= _dirtyLog.size()) {
+    _dirtyLog.erase(_dirtyLog.begin(), _dirtyLog.begin() + _dirtyLogHead);
+    _dirtyLogHead = 0;
+  }
 
-  for (size_t i = 0; i < kSpanClassCount; i++) {
-    _dirty[i].clear();
+  releaseSpans(purged);
+  for (auto const &span : purged) {
+    insertFree(_clean, _cleanBitmap, span);
   }
+}
 
-  _dirtyPageCount = 0;
+void MeshableArena::scavenge(bool force) {
+  if (!force && _dirtyPageCount < kMinDirtyPageThreshold)
+    return;
 
-  for (size_t i = 0; i < kSpanClassCount; i++) {
-    _clean[i].clear();
+  // first, untrack the spans in the meshed bitmap
+  for (auto const &span : _toReset) {
+    untrackMeshed(span);
   }
 
-  // coalesce adjacent spans
-  Span current(0, 0);
-  for (auto const &i : bitmap) {
-    if (i == current.offset + current.length) {
-      current.length++;
-      continue;
-    }
-
-    // should only be empty the first time/iteration through
-    if (!current.empty()) {
-      _clean[current.spanClass()].push_back(current);
-      // debug("  clean: %4zu/%4zu\n", current.offset, current.length);
-    }
+  // the identity mapping of adjacent spans is itself contiguous, so
+  // each run of pages can be reset with a single mmap
+  coalesceSpans(_toReset);
+  for (auto const &span : _toReset) {
+    resetSpanMapping(span);
+  }
 
-    current = Span(i, 1);
+  _meshedPageCount = _meshedBitmap.inUseCount();
+  if (_meshedPageCount > _meshedPageCountHWM) {
+    _meshedPageCountHWM = _meshedPageCount;
+    // TODO: find rss at peak
   }
 
-  // should only be empty the first time/iteration through
-  if (!current.empty()) {
-    _clean[current.spanClass()].push_back(current);
-    // debug("  clean: %4zu/%4zu\n", current.offset, current.length);
+  // only the spans being released or reset are touched here; each
+  // is merged with the clean runs around it as it is filed.  When
+  // dirty pages decay, the background thread releases them as they
+  // age instead.
+  if (force || !_dirtyDecayEnabled) {
+    internal::vector<Span> dirty;
+    cleanDirtySpans(dirty);
+    releaseSpans(dirty);
   }
-#ifndef NDEBUG
-  auto newBitmap = allocatedBitmap();
-  newBitmap.invert();
 
-  const size_t *bits1 = bitmap.bits();
-  const size_t *bits2 = newBitmap.bits();
-  for (size_t i = 0; i < bitmap.byteCount() / sizeof(size_t); i++) {
-    if (bits1[i] != bits2[i]) {
-      debug("bitmaps don't match %zu:\n", i);
-      debug("\t%s\n", bitmap.to_string().c_str());
-      debug("\t%s\n", newBitmap.to_string().c_str());
-      hard_assert(false);
-    }
+  for (auto const &span : _toReset) {
+    insertFree(_clean, _cleanBitmap, span);
   }
-#endif
+
+  // now that we've finally reset to identity all delayed-reset
+  // mappings, empty the list
+  _toReset.clear();
 }
 
 void MeshableArena::freePhys(void *ptr, size_t sz) {
@@ -425,40 +539,209 @@ void MeshableArena::freePhys(void *ptr, size_t sz) {
   d_assert(sz / CPUInfo::PageSize > 0);
   d_assert(sz % CPUInfo::PageSize == 0);
 
-  const off_t off = reinterpret_cast<char *>(ptr) - reinterpret_cast<char *>(_arenaBegin);
+  const Span span(offsetFor(ptr), sz / kPageSize);
+  if (_punchNotifyFd < 0) {
+    punchHole(span);
+    return;
+  }
+
+  if (_punchQueue.empty()) {
+    const uint64_t one = 1;
+    const auto written = write(_punchNotifyFd, &one, sizeof(one));
+    d_assert(written == sizeof(one));
+  }
+  _punchQueue.push_back(span);
+}
+
+void MeshableArena::punchHole(const Span &span) {
+  // coalesced spans may run from the end of one arena's file into
+  // the start of the next
+  forEachArenaPiece(span, [&](const Span &piece) {
 #ifndef __APPLE__
-  int result = fallocate(_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, off, sz);
-  d_assert(result == 0);
+    int result = fallocate(fdFor(piece.offset), FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                           fileOffsetFor(piece.offset), piece.byteLength());
+    d_assert(result == 0);
 #else
 #warning macOS version of fallocate goes here
 #endif
+  });
 }
 
-void MeshableArena::beginMesh(void *keep, void *remove, size_t sz) {
-  int r = mprotect(remove, sz, PROT_READ);
-  hard_assert(r == 0);
+void MeshableArena::setAsyncPunch(int notifyFd) {
+  _punchNotifyFd = notifyFd;
+  if (notifyFd < 0) {
+    coalesceSpans(_punchQueue);
+    for (auto const &span : _punchQueue) {
+      punchHole(span);
+    }
+    _punchQueue.clear();
+  }
 }
 
-void MeshableArena::finalizeMesh(void *keep, void *remove, size_t sz) {
-  // debug("keep: %p, remove: %p\n", keep, remove);
-  const auto keepOff = offsetFor(keep);
-  const auto removeOff = offsetFor(remove);
+bool MeshableArena::beginPunches() {
+  if (_punchQueue.empty()) {
+    return false;
+  }
 
-  const Length pageCount = sz / kPageSize;
-  const MiniHeapID keepID = _mhIndex[keepOff].load(std::memory_order_acquire);
-  for (size_t i = 0; i < pageCount; i++) {
-    setIndex(removeOff + i, keepID);
+  // holding _punchLock until finishPunches is what makes findPages
+  // wait for the batch to land before reusing any of it
+  _punchLock.lock();
+  _punching.clear();
+  std::swap(_punching, _punchQueue);
+  coalesceSpans(_punching);
+  return true;
+}
+
+void MeshableArena::finishPunches() {
+  for (auto const &span : _punching) {
+    punchHole(span);
   }
+  _punchLock.unlock();
+}
 
-  const Span removedSpan{removeOff, pageCount};
-  trackMeshed(removedSpan);
+// span is about to be handed out again: drop it from the queued
+// punches, and wait for the in-flight batch if that overlaps it
+void MeshableArena::cancelPunches(const Span &span) {
+  const auto overlaps = [&span](const Span &other) {
+    return other.offset < span.offset + span.length && span.offset < other.offset + other.length;
+  };
 
-  void *ptr = mmap(remove, sz, HL_MMAP_PROTECTION_MASK, kMapShared | MAP_FIXED, _fd, keepOff * kPageSize);
-  hard_assert_msg(ptr != MAP_FAILED, "mesh remap failed: %d", errno);
-  freePhys(remove, sz);
+  for (size_t i = 0; i < _punchQueue.size();) {
+    const Span queued = _punchQueue[i];
+    if (!overlaps(queued)) {
+      i++;
+      continue;
+    }
 
-  int r = mprotect(remove, sz, PROT_READ | PROT_WRITE);
-  hard_assert(r == 0);
+    _punchQueue[i] = _punchQueue.back();
+    _punchQueue.pop_back();
+    if (queued.offset < span.offset) {
+      _punchQueue.push_back(Span(queued.offset, span.offset - queued.offset));
+    }
+    const size_t spanEnd = span.offset + span.length;
+    const size_t queuedEnd = queued.offset + queued.length;
+    if (queuedEnd > spanEnd) {
+      _punchQueue.push_back(Span(spanEnd, queuedEnd - spanEnd));
+    }
+  }
+
+  for (auto const &punching : _punching) {
+    if (overlaps(punching)) {
+      lock_guard<mutex> wait(_punchLock);
+      break;
+    }
+  }
+}
+
+void MeshableArena::releaseSpans(internal::vector<Span> &spans) {
+  coalesceSpans(spans);
+
+  for (auto const &span : spans) {
+    auto ptr = ptrFromOffset(span.offset);
+    auto sz = span.byteLength();
+    madvise(ptr, sz, MADV_DONTNEED);
+    freePhys(ptr, sz);
+  }
+}
+
+void MeshableArena::beginMesh(internal::vector<Span> &removeSpans) {
+  coalesceSpans(removeSpans);
+
+  for (auto const &span : removeSpans) {
+    int r = mprotect(ptrFromOffset(span.offset), span.byteLength(), PROT_READ);
+    hard_assert(r == 0);
+  }
+}
+
+void MeshableArena::finalizeMesh(internal::vector<SpanMesh> &meshes) {
+  if (meshes.empty()) {
+    return;
+  }
+
+  std::sort(meshes.begin(), meshes.end(),
+            [](const SpanMesh &a, const SpanMesh &b) { return a.remove.offset < b.remove.offset; });
+
+  internal::vector<Span> removed;
+  removed.reserve(meshes.size());
+
+  for (auto const &mesh : meshes) {
+    const Span &keep = mesh.keep;
+    const Span &remove = mesh.remove;
+    d_assert(keep.length == remove.length);
+
+    const MiniHeapID keepID = _mhIndex[keep.offset].load(std::memory_order_acquire);
+    for (size_t i = 0; i < remove.length; i++) {
+      setIndex(remove.offset + i, keepID);
+    }
+
+    trackMeshed(remove);
+    removed.push_back(remove);
+  }
+
+  // a run of remove spans whose keep spans are laid out the same way
+  // in one arena file can be remapped with a single mmap.  The new
+  // mapping is read/write, which also undoes beginMesh's mprotect.
+  for (size_t i = 0; i < meshes.size();) {
+    if (meshes[i].pageMask != 0) {
+      remapPages(meshes[i]);
+      i++;
+      continue;
+    }
+
+    const Offset keepOff = meshes[i].keep.offset;
+    const Offset removeOff = meshes[i].remove.offset;
+    Length pageCount = meshes[i].remove.length;
+
+    size_t j = i + 1;
+    for (; j < meshes.size(); j++) {
+      if (meshes[j].pageMask != 0 || meshes[j].remove.offset != removeOff + pageCount ||
+          meshes[j].keep.offset != keepOff + pageCount || arenaStart(meshes[j].keep.offset) != arenaStart(keepOff)) {
+        break;
+      }
+      pageCount += meshes[j].remove.length;
+    }
+
+    void *remove = ptrFromOffset(removeOff);
+    void *ptr = mmap(remove, Span(removeOff, pageCount).byteLength(), HL_MMAP_PROTECTION_MASK, kMapShared | MAP_FIXED, fdFor(keepOff),
+                     fileOffsetFor(keepOff));
+    hard_assert_msg(ptr != MAP_FAILED, "mesh remap failed: %d", errno);
+
+    i = j;
+  }
+
+  coalesceSpans(removed);
+  for (auto const &span : removed) {
+    freePhys(ptrFromOffset(span.offset), span.byteLength());
+  }
+}
+
+void MeshableArena::remapPages(const SpanMesh &mesh) {
+  const Length length = mesh.remove.length;
+  d_assert(length <= 64);
+
+  for (size_t page = 0; page < length;) {
+    const bool occupied = (mesh.pageMask >> page) & 1;
+    size_t end = page + 1;
+    while (end < length && ((mesh.pageMask >> end) & 1) == occupied) {
+      end++;
+    }
+
+    void *remove = ptrFromOffset(mesh.remove.offset + page);
+    const size_t sz = (end - page) * kPageSize;
+    if (occupied) {
+      const Offset keepOff = mesh.keep.offset + page;
+      void *ptr =
+          mmap(remove, sz, HL_MMAP_PROTECTION_MASK, kMapShared | MAP_FIXED, fdFor(keepOff), fileOffsetFor(keepOff));
+      hard_assert_msg(ptr != MAP_FAILED, "mesh remap failed: %d", errno);
+    } else {
+      // nothing live here: the pages stay on remove's own (about to
+      // be released) file range, and only need to be writable again
+      int r = mprotect(remove, sz, PROT_READ | PROT_WRITE);
+      hard_assert(r == 0);
+    }
+
+    page = end;
+  }
 }
 
 int MeshableArena::openShmSpanFile(size_t sz) {
@@ -557,8 +840,10 @@ void MeshableArena::prepareForFork() {
   // debug("%d: prepare fork", getpid());
   runtime().heap().lock();
   runtime().lock();
+  // don't fork in the middle of a batch of hole punches
+  _punchLock.lock();
 
-  int r = mprotect(_arenaBegin, kArenaSize, PROT_READ);
+  int r = mprotect(_arenaBegin, mappedSize(), PROT_READ);
   hard_assert(r == 0);
 
   int err = pipe(_forkPipe);
@@ -591,10 +876,11 @@ void MeshableArena::afterForkParent() {
 
   // only after the child has finished copying the heap is it safe to
   // go back to read/write
-  int r = mprotect(_arenaBegin, kArenaSize, PROT_READ | PROT_WRITE);
+  int r = mprotect(_arenaBegin, mappedSize(), PROT_READ | PROT_WRITE);
   hard_assert(r == 0);
 
   // debug("%d: after fork parent", getpid());
+  _punchLock.unlock();
   runtime().unlock();
   runtime().heap().unlock();
 }
@@ -616,35 +902,49 @@ void MeshableArena::afterForkChild() {
   }
 
   // debug("%d: after fork child", getpid());
+  _punchLock.unlock();
   runtime().unlock();
   runtime().heap().unlock();
 
+  // the background thread doesn't survive the fork, and the queued
+  // punches were against the parent's file, whose free pages the
+  // child never copies
+  _punchQueue.clear();
+  _punching.clear();
+  _punchNotifyFd = -1;
+  setDirtyDecay(false);
+
   close(_forkPipe[0]);
 
   char *oldSpanDir = _spanDir;
 
-  // open new file for the arena
-  int newFd = openSpanFile(kArenaSize);
-
-  struct stat fileinfo;
-  memset(&fileinfo, 0, sizeof(fileinfo));
-  fstat(newFd, &fileinfo);
-  d_assert(fileinfo.st_size >= 0 && (size_t)fileinfo.st_size == kArenaSize);
+  // open new files for the arenas
+  int oldFds[kMaxArenaCount];
+  for (size_t i = 0; i < _arenaCount; i++) {
+    oldFds[i] = _fds[i];
+    _fds[i] = openSpanFile(kArenaSize);
 
-  const int oldFd = _fd;
+    struct stat fileinfo;
+    memset(&fileinfo, 0, sizeof(fileinfo));
+    fstat(_fds[i], &fileinfo);
+    d_assert(fileinfo.st_size >= 0 && (size_t)fileinfo.st_size == kArenaSize);
+  }
 
   const auto bitmap = allocatedBitmap();
   for (auto const &i : bitmap) {
-    int result = internal::copyFile(newFd, oldFd, i * kPageSize, kPageSize);
+    int result = internal::copyFile(fdFor(i), oldFds[i / kArenaPageCount], fileOffsetFor(i), kPageSize);
     d_assert(result == CPUInfo::PageSize);
   }
 
-  int r = mprotect(_arenaBegin, kArenaSize, PROT_READ | PROT_WRITE);
+  int r = mprotect(_arenaBegin, mappedSize(), PROT_READ | PROT_WRITE);
   hard_assert(r == 0);
 
-  // remap the new region over the old
-  void *ptr = mmap(_arenaBegin, kArenaSize, HL_MMAP_PROTECTION_MASK, kMapShared | MAP_FIXED, newFd, 0);
-  hard_assert_msg(ptr != MAP_FAILED, "map failed: %d", errno);
+  // remap the new files over the old
+  for (size_t i = 0; i < _arenaCount; i++) {
+    void *begin = reinterpret_cast<char *>(_arenaBegin) + i * kArenaSize;
+    void *ptr = mmap(begin, kArenaSize, HL_MMAP_PROTECTION_MASK, kMapShared | MAP_FIXED, _fds[i], 0);
+    hard_assert_msg(ptr != MAP_FAILED, "map failed: %d", errno);
+  }
 
   // re-do the meshed mappings
   {
@@ -679,7 +979,8 @@ void MeshableArena::afterForkChild() {
         }
 #endif
 
-        void *ptr = mmap(remove, sz, HL_MMAP_PROTECTION_MASK, kMapShared | MAP_FIXED, _fd, keepOff * kPageSize);
+        void *ptr = mmap(remove, sz, HL_MMAP_PROTECTION_MASK, kMapShared | MAP_FIXED, fdFor(keepOff),
+                         fileOffsetFor(keepOff));
 
         hard_assert_msg(ptr != MAP_FAILED, "mesh remap failed: %d", errno);
 
@@ -688,11 +989,11 @@ void MeshableArena::afterForkChild() {
     }
   }
 
-  _fd = newFd;
-
   internal::Heap().free(oldSpanDir);
 
-  close(oldFd);
+  for (size_t i = 0; i < _arenaCount; i++) {
+    close(oldFds[i]);
+  }
 
   while (write(_forkPipe[1], "ok", strlen("ok")) == EAGAIN) {
   }
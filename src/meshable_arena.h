@@ -34,6 +34,8 @@
 
 #include "mmap_heap.h"
 
+#include "span_index.h"
+
 #ifndef MADV_DONTDUMP
 #define MADV_DONTDUMP 0
 #endif
@@ -44,6 +46,20 @@
 
 namespace mesh {
 
+// a request to point the virtual span remove at the physical pages
+// backing keep (the two are the same length).  A non-zero pageMask
+// limits the remap to the pages of remove whose bits are set; the
+// rest hold no live objects and are left where they are.
+struct SpanMesh {
+  explicit SpanMesh(const Span &keep_, const Span &remove_, uint64_t pageMask_ = 0)
+      : keep(keep_), remove(remove_), pageMask(pageMask_) {
+  }
+
+  Span keep;
+  Span remove;
+  uint64_t pageMask;
+};
+
 class MeshableArena : public mesh::OneWayMmapHeap {
 private:
   DISALLOW_COPY_AND_ASSIGN(MeshableArena);
@@ -52,12 +68,20 @@ private:
 public:
   enum { Alignment = kPageSize };
 
+  static constexpr size_t kArenaPageCount = kArenaSize / kPageSize;
+  static constexpr size_t kMaxPageCount = kMaxHeapSize / kPageSize;
+
   explicit MeshableArena();
 
   inline bool contains(const void *ptr) const {
     auto arena = reinterpret_cast<uintptr_t>(_arenaBegin);
     auto ptrval = reinterpret_cast<uintptr_t>(ptr);
-    return arena <= ptrval && ptrval < arena + kArenaSize;
+    return arena <= ptrval && ptrval < arena + kMaxHeapSize;
+  }
+
+  // the number of kArenaSize arenas chained so far
+  inline size_t arenaCount() const {
+    return _arenaCount;
   }
 
   char *pageAlloc(Span &result, size_t pageCount, size_t pageAlignment = 1);
@@ -99,8 +123,14 @@ public:
     return miniheapForArenaOffset(arenaOff);
   }
 
-  void beginMesh(void *keep, void *remove, size_t sz);
-  void finalizeMesh(void *keep, void *remove, size_t sz);
+  // marks the virtual spans about to be meshed away read-only.
+  // Adjacent spans are coalesced so that a whole batch of meshes
+  // costs as few mprotect calls as possible.
+  void beginMesh(internal::vector<Span> &removeSpans);
+  // points each remove span at the physical pages backing its keep
+  // span, and releases the physical pages that used to back the
+  // remove spans.
+  void finalizeMesh(internal::vector<SpanMesh> &meshes);
 
   inline bool aboveMeshThreshold() const {
     return _meshedPageCount > _maxMeshCount;
@@ -121,6 +151,27 @@ public:
   // like a scavenge, but we only MADV_FREE
   void partialScavenge();
 
+  // starts (or stops) timestamping dirty frees so that
+  // decayDirtyPages can purge them by age
+  void setDirtyDecay(bool enabled);
+  // advances the decay clock by one epoch, and returns the dirty
+  // pages that have outlived the decay curve to the OS, oldest first
+  void decayDirtyPages();
+
+  inline size_t dirtyPageCount() const {
+    return _dirtyPageCount;
+  }
+
+  // queues hole punches for a background thread rather than issuing
+  // them inline, writing to notifyFd whenever the queue becomes
+  // non-empty.  -1 goes back to punching synchronously.
+  void setAsyncPunch(int notifyFd);
+  // hands the queued punches to the caller's thread.  Called under
+  // the heap lock; returns false if there is nothing to do, otherwise
+  // finishPunches must be called (without the heap lock) afterwards.
+  bool beginPunches();
+  void finishPunches();
+
   // return the maximum number of pages we've had meshed (and thus our
   // savings) at any point in time.
   inline size_t meshedPageHighWaterMark() const {
@@ -135,18 +186,30 @@ public:
     return reinterpret_cast<char *>(_arenaBegin);
   }
   void *arenaEnd() const {
-    return reinterpret_cast<char *>(_arenaBegin) + kArenaSize;
+    return reinterpret_cast<char *>(_arenaBegin) + kMaxHeapSize;
   }
 
   void doAfterForkChild();
 
 private:
   void expandArena(Length minPagesAdded);
-  bool findPages(Length pageCount, Span &result, internal::PageType &type);
-  bool findPagesInner(internal::vector<Span> freeSpans[kSpanClassCount], size_t i, Length pageCount, Span &result);
+  void addArena();
+  bool findPages(Length pageCount, Length pageAlignment, Span &result, internal::PageType &type);
+  Offset alignedOffset(const Span &span, Length pageAlignment) const;
+  Span carve(Span span, Length pageCount, Length pageAlignment, SpanIndex &spans);
+  void insertFree(SpanIndex &spans, internal::RelaxedBitmap &pages, const Span &span);
+  void cleanDirtySpans(internal::vector<Span> &dirty);
+  void takeDirtyPages(const Span &span, internal::vector<Span> &taken);
+  size_t dirtyDecayLimit() const;
   Span reservePages(Length pageCount, Length pageAlignment);
   void freePhys(void *ptr, size_t sz);
-  internal::RelaxedBitmap allocatedBitmap(bool includeDirty = true) const;
+  void punchHole(const Span &span);
+  void cancelPunches(const Span &span);
+  // MADV_DONTNEED and free the physical pages behind spans, with one
+  // pair of syscalls per contiguous run.  spans is sorted and
+  // coalesced in place.
+  void releaseSpans(internal::vector<Span> &spans);
+  internal::RelaxedBitmap allocatedBitmap() const;
 
   void *malloc(size_t sz) = delete;
 
@@ -155,8 +218,41 @@ private:
   }
 
   static constexpr size_t indexSize() {
-    // one pointer per page in our arena
-    return sizeof(Offset) * (kArenaSize / kPageSize);
+    // one pointer per page in any of our arenas
+    return sizeof(Offset) * kMaxPageCount;
+  }
+
+  // the first page of the arena that page off belongs to.  Every
+  // span lies within a single arena, as it is backed by that arena's
+  // file.
+  static inline Offset arenaStart(Offset off) {
+    return off - off % kArenaPageCount;
+  }
+
+  // the file backing page off, and where in that file it lives
+  inline int fdFor(Offset off) const {
+    return _fds[off / kArenaPageCount];
+  }
+
+  static inline off_t fileOffsetFor(Offset off) {
+    return static_cast<off_t>(off % kArenaPageCount) * kPageSize;
+  }
+
+  // calls func on each piece of span that lies within a single arena
+  template <typename Func>
+  static inline void forEachArenaPiece(const Span &span, const Func func) {
+    Offset off = span.offset;
+    const Offset end = span.offset + span.length;
+    while (off < end) {
+      const Offset pieceEnd = std::min<Offset>(end, arenaStart(off) + kArenaPageCount);
+      func(Span(off, pieceEnd - off));
+      off = pieceEnd;
+    }
+  }
+
+  // the bytes of address space currently backed by arenas
+  inline size_t mappedSize() const {
+    return _arenaCount * kArenaSize;
   }
 
   inline void clearIndex(const Span &span) {
@@ -171,10 +267,10 @@ private:
       return;
     }
 
-    // this happens when we are trying to get an aligned allocation
-    // and returning excess back to the arena
+    // pages that were never written to go straight back to the
+    // clean index
     if (flags == internal::PageType::Clean) {
-      _clean[span.spanClass()].push_back(span);
+      insertFree(_clean, _cleanBitmap, span);
       return;
     }
 
@@ -182,11 +278,15 @@ private:
 
     if (flags == internal::PageType::Dirty) {
       if (kAdviseDump) {
-        madvise(ptrFromOffset(span.offset), span.length * kPageSize, MADV_DONTDUMP);
+        madvise(ptrFromOffset(span.offset), span.byteLength(), MADV_DONTDUMP);
       }
       d_assert(span.length > 0);
-      _dirty[span.spanClass()].push_back(span);
+      insertFree(_dirty, _dirtyBitmap, span);
       _dirtyPageCount += span.length;
+      if (_dirtyDecayEnabled) {
+        _dirtyLog.push_back(DirtyFree{_decayEpoch, span});
+        _decayFreed[_decayEpoch % kDirtyDecaySteps] += span.length;
+      }
       if (_dirtyPageCount > kMaxDirtyPageThreshold) {
         partialScavenge();
       }
@@ -252,10 +352,14 @@ private:
     }
   }
 
+  // remaps only the pages of mesh.remove selected by mesh.pageMask
+  void remapPages(const SpanMesh &mesh);
+
   inline void resetSpanMapping(const Span &span) {
-    auto ptr = ptrFromOffset(span.offset);
-    auto sz = span.byteLength();
-    mmap(ptr, sz, HL_MMAP_PROTECTION_MASK, kMapShared | MAP_FIXED, _fd, span.offset * kPageSize);
+    forEachArenaPiece(span, [&](const Span &piece) {
+      mmap(ptrFromOffset(piece.offset), piece.byteLength(), HL_MMAP_PROTECTION_MASK, kMapShared | MAP_FIXED,
+           fdFor(piece.offset), fileOffsetFor(piece.offset));
+    });
   }
 
   void prepareForFork();
@@ -267,7 +371,7 @@ private:
   atomic<MiniHeapID> *_mhIndex{nullptr};
 
 protected:
-  CheapHeap<64, kArenaSize / kPageSize> _mhAllocator{};
+  CheapHeap<64, kMaxPageCount> _mhAllocator{};
 
 private:
   Offset _end{};  // in pages
@@ -276,20 +380,56 @@ private:
   // to identity mappings in the page tables.
   internal::vector<Span> _toReset;
 
-  internal::vector<Span> _clean[kSpanClassCount];
-  internal::vector<Span> _dirty[kSpanClassCount];
+  SpanIndex _clean{};
+  SpanIndex _dirty{};
+
+  // one bit per page, set for exactly the pages in _clean and
+  // _dirty respectively.  Each maximal run of set bits is a single
+  // entry in the matching index.
+  internal::RelaxedBitmap _cleanBitmap{
+      kMaxPageCount, reinterpret_cast<char *>(OneWayMmapHeap().malloc(bitmap::representationSize(kMaxPageCount))),
+      false};
+  internal::RelaxedBitmap _dirtyBitmap{
+      kMaxPageCount, reinterpret_cast<char *>(OneWayMmapHeap().malloc(bitmap::representationSize(kMaxPageCount))),
+      false};
 
   size_t _dirtyPageCount{0};
 
+  // dirty frees in the order they happened, tagged with the decay
+  // epoch they happened in.  A record can outlive its pages (they
+  // may have been reallocated since), so purging only ever touches
+  // the pages of a record that are still dirty.
+  struct DirtyFree {
+    uint64_t epoch;
+    Span span;
+  };
+  internal::vector<DirtyFree> _dirtyLog{};
+  size_t _dirtyLogHead{0};
+  // pages freed dirty in each of the last kDirtyDecaySteps epochs
+  size_t _decayFreed[kDirtyDecaySteps]{};
+  uint64_t _decayEpoch{0};
+  bool _dirtyDecayEnabled{false};
+
+  // file ranges waiting to be punched by the background thread, and
+  // the batch it is currently punching (under _punchLock, which it
+  // holds until the whole batch is done).  Pages are only reused out
+  // of the clean index, where reuse cancels a queued punch and waits
+  // out an in-flight one.
+  internal::vector<Span> _punchQueue{};
+  internal::vector<Span> _punching{};
+  mutex _punchLock{};
+  int _punchNotifyFd{-1};
+
   internal::RelaxedBitmap _meshedBitmap{
-      kArenaSize / kPageSize,
-      reinterpret_cast<char *>(OneWayMmapHeap().malloc(bitmap::representationSize(kArenaSize / kPageSize))), false};
+      kMaxPageCount, reinterpret_cast<char *>(OneWayMmapHeap().malloc(bitmap::representationSize(kMaxPageCount))),
+      false};
   size_t _meshedPageCount{0};
   size_t _meshedPageCountHWM{0};
   size_t _rssKbAtHWM{0};
   size_t _maxMeshCount{kDefaultMaxMeshCount};
 
-  int _fd;
+  int _fds[kMaxArenaCount];
+  size_t _arenaCount{0};
   int _forkPipe[2]{-1, -1};  // used for signaling during fork
   char *_spanDir{nullptr};
 };
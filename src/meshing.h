@@ -6,9 +6,14 @@
 #define MESH__MESHING_H
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <limits>
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 #include "common.h"
 
 #include "internal.h"
@@ -16,6 +21,7 @@
 
 #include "binned_tracker.h"
 #include "bitmap.h"
+#include "bitmap_mirror.h"
 
 namespace mesh {
 
@@ -41,6 +47,94 @@ inline bool bitmapsMeshable(const Bitmap::word_t *__restrict__ bitmap1, const Bi
   return true;
 }
 
+// the maximum number of bitmaps bitmapsMeshableMask compares against
+// a single left-hand bitmap in one call.
+static constexpr size_t kMeshableMaskWidth = 8;
+
+namespace internal {
+
+typedef uint32_t (*MeshableMaskFn)(const Bitmap::word_t *bitmap, const Bitmap::word_t *const *others, size_t n);
+
+inline uint32_t meshableMaskScalar(const Bitmap::word_t *bitmap, const Bitmap::word_t *const *others,
+                                   size_t n) noexcept {
+  uint32_t mask = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (bitmapsMeshable(bitmap, others[i], 32)) {
+      mask |= 1U << i;
+    }
+  }
+  return mask;
+}
+
+#if defined(__x86_64__)
+// one vptest per candidate: the 32-byte bitmap fits in a single ymm
+// register, and the candidate loads are independent of each other.
+__attribute__((target("avx2"))) inline uint32_t meshableMaskAVX2(const Bitmap::word_t *bitmap,
+                                                                 const Bitmap::word_t *const *others,
+                                                                 size_t n) noexcept {
+  const __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bitmap));
+
+  uint32_t mask = 0;
+  for (size_t i = 0; i < n; i++) {
+    const __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(others[i]));
+    mask |= static_cast<uint32_t>(_mm256_testz_si256(left, right)) << i;
+  }
+  return mask;
+}
+
+// the left bitmap is broadcast into both halves of a zmm register, so
+// each vptestmq checks two candidates at once, producing one bit per
+// 64-bit word.  A candidate is meshable when its nibble is empty.
+__attribute__((target("avx512f"))) inline uint32_t meshableMaskAVX512(const Bitmap::word_t *bitmap,
+                                                                     const Bitmap::word_t *const *others,
+                                                                     size_t n) noexcept {
+  const __m256i left256 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bitmap));
+  const __m512i left = _mm512_broadcast_i64x4(left256);
+
+  uint32_t mask = 0;
+  size_t i = 0;
+  for (; i + 1 < n; i += 2) {
+    const __m256i r0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(others[i]));
+    const __m256i r1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(others[i + 1]));
+    const __m512i right = _mm512_inserti64x4(_mm512_castsi256_si512(r0), r1, 1);
+    const uint32_t overlap = _mm512_test_epi64_mask(left, right);
+    mask |= static_cast<uint32_t>((overlap & 0x0f) == 0) << i;
+    mask |= static_cast<uint32_t>((overlap & 0xf0) == 0) << (i + 1);
+  }
+  if (i < n) {
+    const __m256i r0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(others[i]));
+    const uint32_t overlap = _mm512_test_epi64_mask(left, _mm512_castsi256_si512(r0));
+    mask |= static_cast<uint32_t>((overlap & 0x0f) == 0) << i;
+  }
+  return mask;
+}
+#endif
+
+inline MeshableMaskFn resolveMeshableMask() noexcept {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return meshableMaskAVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return meshableMaskAVX2;
+  }
+#endif
+  return meshableMaskScalar;
+}
+}  // namespace internal
+
+// tests bitmap against each of the n (at most kMeshableMaskWidth)
+// 32-byte bitmaps in others, returning a mask with bit i set if
+// others[i] is meshable with bitmap.  The kernel is picked once, at
+// first use, based on what the CPU we are running on supports.
+inline uint32_t bitmapsMeshableMask(const Bitmap::word_t *bitmap, const Bitmap::word_t *const *others,
+                                    size_t n) noexcept {
+  d_assert(n <= kMeshableMaskWidth);
+  static const internal::MeshableMaskFn meshableMask = internal::resolveMeshableMask();
+  return meshableMask(bitmap, others, n);
+}
+
 namespace method {
 
 // split miniheaps into two lists in a random order
@@ -85,33 +179,589 @@ inline void shiftedSplitting(MWC &prng, BinnedTracker &miniheaps,
 
   size_t foundCount = 0;
   for (size_t j = 0; j < leftSize; j++) {
-    const size_t idxLeft = j;
+    auto h1 = leftBucket[j];
+    const auto bitmap1 = h1->bitmap().bits();
+
     size_t idxRight = j;
-    for (size_t i = 0; i < limit; i++, idxRight++) {
-      if (unlikely(idxRight >= rightSize)) {
-        idxRight %= rightSize;
+    for (size_t i = 0; i < limit;) {
+      // gather the next batch of untaken candidates in our window, and
+      // test them against h1 all at once
+      const Bitmap::word_t *others[kMeshableMaskWidth];
+      size_t idxs[kMeshableMaskWidth];
+      size_t n = 0;
+      for (; i < limit && n < kMeshableMaskWidth; i++, idxRight++) {
+        if (unlikely(idxRight >= rightSize)) {
+          idxRight %= rightSize;
+        }
+        auto h2 = rightBucket[idxRight];
+        if (h2 == nullptr)
+          continue;
+        others[n] = h2->bitmap().bits();
+        idxs[n] = idxRight;
+        n++;
       }
-      auto h1 = leftBucket[idxLeft];
-      auto h2 = rightBucket[idxRight];
 
-      if (h1 == nullptr || h2 == nullptr)
+      if (n == 0)
+        break;
+
+      const uint32_t mask = mesh::bitmapsMeshableMask(bitmap1, others, n);
+      if (likely(mask == 0))
         continue;
 
-      const auto bitmap1 = h1->bitmap().bits();
-      const auto bitmap2 = h2->bitmap().bits();
-
-      if (unlikely(mesh::bitmapsMeshable(bitmap1, bitmap2, nBytes))) {
-        std::pair<MiniHeap *, MiniHeap *> heaps{h1, h2};
-        meshFound(std::move(heaps));
-        leftBucket[idxLeft] = nullptr;
-        rightBucket[idxRight] = nullptr;
-        foundCount++;
-        if (foundCount > kMaxMeshesPerIteration) {
-          return;
+      const size_t idx = idxs[__builtin_ctz(mask)];
+      std::pair<MiniHeap *, MiniHeap *> heaps{h1, rightBucket[idx]};
+      meshFound(std::move(heaps));
+      leftBucket[j] = nullptr;
+      rightBucket[idx] = nullptr;
+      foundCount++;
+      if (foundCount > kMaxMeshesPerIteration) {
+        return;
+      }
+      break;
+    }
+  }
+}
+
+// row-level meshers search a BitmapMirror snapshot of a size class's
+// candidates, reporting (dst, src) row pairs.  Pairs that share a dst
+// and are reported back-to-back form a multi-way group.  Meshers
+// return the number of bitmap comparisons they performed.
+typedef function<void(size_t, size_t)> RowMeshFound;
+typedef size_t (*Mesher)(MWC &prng, BitmapMirror &rows, size_t objectCount, const RowMeshFound &meshFound);
+
+// greedily builds multi-way meshes: candidates are shuffled, and each
+// one in turn keeps OR-ing in the bitmaps of the next t untaken
+// candidates for as long as they stay disjoint.  Each group found
+// this way is reported as (dst, src) pairs sharing one destination --
+// the member with the longest mesh chain -- so that k spans collapse
+// into one in a single pass rather than over k - 1 mesh periods.
+template <size_t t = 64>
+inline size_t shiftedGroupingRows(MWC &prng, BitmapMirror &rows, size_t objectCount,
+                                  const RowMeshFound &meshFound) noexcept {
+  rows.shuffle(prng);
+
+  const auto size = rows.size();
+  if (size < 2)
+    return 0;
+
+  const size_t limit = size - 1 < t ? size - 1 : t;
+  constexpr size_t nWords = BitmapMirror::kWords;
+
+  internal::vector<bool> taken(size, false);
+  size_t group[kMaxMeshGroupSize];
+
+  size_t foundCount = 0;
+  size_t comparisons = 0;
+  for (size_t j = 0; j < size; j++) {
+    if (taken[j])
+      continue;
+
+    size_t groupSize = 0;
+    group[groupSize++] = j;
+    size_t groupMeshCount = rows.meshCount(j);
+
+    Bitmap::word_t occupied[nWords] __attribute__((aligned(16)));
+    memcpy(static_cast<void *>(occupied), rows.bitmap(j), sizeof(occupied));
+
+    size_t idx = j + 1;
+    for (size_t i = 0; i < limit && groupSize < kMaxMeshGroupSize;) {
+      const Bitmap::word_t *others[kMeshableMaskWidth];
+      size_t idxs[kMeshableMaskWidth];
+      size_t n = 0;
+      for (; i < limit && n < kMeshableMaskWidth; i++, idx++) {
+        if (unlikely(idx >= size)) {
+          idx %= size;
         }
+        if (taken[idx] || idx == j)
+          continue;
+        others[n] = rows.bitmap(idx);
+        idxs[n] = idx;
+        n++;
       }
+
+      if (n == 0)
+        break;
+
+      uint32_t mask = mesh::bitmapsMeshableMask(occupied, others, n);
+      comparisons += n;
+      bool grew = false;
+      while (mask != 0 && groupSize < kMaxMeshGroupSize) {
+        const size_t k = __builtin_ctz(mask);
+        mask &= mask - 1;
+
+        // the batch was tested against the group as it was before
+        // this batch, so later hits need re-checking once it grows
+        if (grew && (++comparisons, !mesh::bitmapsMeshable(occupied, others[k], sizeof(occupied))))
+          continue;
+
+        const auto meshCount = rows.meshCount(idxs[k]);
+        if (groupMeshCount + meshCount > kMaxMeshes)
+          continue;
+
+        for (size_t w = 0; w < nWords; w++) {
+          occupied[w] |= others[k][w];
+        }
+        groupMeshCount += meshCount;
+        group[groupSize++] = idxs[k];
+        taken[idxs[k]] = true;
+        grew = true;
+      }
+    }
+
+    taken[j] = true;
+
+    if (groupSize == 1)
+      continue;
+
+    // merge into the miniheap with the longest existing chain
+    size_t dstIdx = 0;
+    size_t dstMeshCount = 0;
+    for (size_t k = 0; k < groupSize; k++) {
+      const auto meshCount = rows.meshCount(group[k]);
+      if (meshCount > dstMeshCount) {
+        dstIdx = k;
+        dstMeshCount = meshCount;
+      }
+    }
+
+    for (size_t k = 0; k < groupSize; k++) {
+      if (k == dstIdx)
+        continue;
+      meshFound(group[dstIdx], group[k]);
+      foundCount++;
     }
+
+    if (foundCount > kMaxMeshesPerIteration) {
+      return comparisons;
+    }
+  }
+
+  return comparisons;
+}
+
+// row indices of rows, in increasing order of occupancy, so that
+// sparse/sparse pairs are tried first
+inline internal::vector<uint32_t> occupancyOrder(const BitmapMirror &rows) {
+  internal::vector<uint32_t> order(rows.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
   }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](uint32_t a, uint32_t b) { return rows.inUseCount(a) < rows.inUseCount(b); });
+  return order;
+}
+
+// returns the first untaken row in candidates[start:] that can be
+// meshed with row, or -1.  Every bitmap tested is added to
+// comparisons, and the search gives up once kMaxMesherComparisons
+// have been spent.
+inline ssize_t firstMeshable(const BitmapMirror &rows, size_t row, const internal::vector<uint32_t> &candidates,
+                             size_t start, const internal::vector<bool> &taken, size_t &comparisons) {
+  const auto meshCount = rows.meshCount(row);
+  for (size_t i = start; i < candidates.size() && comparisons < kMaxMesherComparisons;) {
+    const Bitmap::word_t *others[kMeshableMaskWidth];
+    size_t idxs[kMeshableMaskWidth];
+    size_t n = 0;
+    for (; i < candidates.size() && n < kMeshableMaskWidth; i++) {
+      const size_t c = candidates[i];
+      if (taken[c] || c == row || meshCount + rows.meshCount(c) > kMaxMeshes)
+        continue;
+      others[n] = rows.bitmap(c);
+      idxs[n] = c;
+      n++;
+    }
+
+    if (n == 0)
+      break;
+
+    comparisons += n;
+    const uint32_t mask = mesh::bitmapsMeshableMask(rows.bitmap(row), others, n);
+    if (mask != 0)
+      return idxs[__builtin_ctz(mask)];
+  }
+  return -1;
+}
+
+// number of set bits among the first bitCount bits of a mirrored row
+inline uint32_t popcountBelow(const uint64_t *row, size_t bitCount) {
+  uint32_t count = 0;
+  size_t w = 0;
+  for (; (w + 1) * 64 <= bitCount; w++) {
+    count += __builtin_popcountl(row[w]);
+  }
+  if (bitCount % 64 != 0) {
+    count += __builtin_popcountl(row[w] & ((1UL << (bitCount % 64)) - 1));
+  }
+  return count;
+}
+
+// a port of greedyMesher from theory/meshers.py: sort candidates by
+// occupancy, then pair each with the first later candidate it meshes
+// with.  Bounded by kMaxMesherComparisons rather than being fully
+// exhaustive.
+inline size_t greedyRows(MWC &prng, BitmapMirror &rows, size_t objectCount, const RowMeshFound &meshFound) noexcept {
+  // shuffle first so that ties in occupancy are broken randomly
+  rows.shuffle(prng);
+
+  const auto size = rows.size();
+  if (size < 2)
+    return 0;
+
+  const auto order = occupancyOrder(rows);
+  internal::vector<bool> taken(size, false);
+  size_t comparisons = 0;
+
+  size_t foundCount = 0;
+  for (size_t a = 0; a < size && comparisons < kMaxMesherComparisons; a++) {
+    const size_t i = order[a];
+    if (taken[i])
+      continue;
+
+    const auto j = firstMeshable(rows, i, order, a + 1, taken, comparisons);
+    if (j < 0)
+      continue;
+
+    taken[i] = true;
+    taken[j] = true;
+    meshFound(i, j);
+    foundCount++;
+    if (foundCount > kMaxMeshesPerIteration) {
+      return comparisons;
+    }
+  }
+
+  return comparisons;
+}
+
+// a port of greedySplittingMesher from theory/meshers.py: candidates
+// are split by whether most of their live objects sit in the first or
+// the second half of the span, so that each half is likely to mesh
+// with the other; each candidate on the left is then paired with the
+// first (lowest occupancy) right candidate it meshes with.
+inline size_t greedySplittingRows(MWC &prng, BitmapMirror &rows, size_t objectCount,
+                                  const RowMeshFound &meshFound) noexcept {
+  rows.shuffle(prng);
+
+  const auto size = rows.size();
+  if (size < 2)
+    return 0;
+
+  const size_t half = objectCount / 2;
+
+  internal::vector<uint32_t> left{};
+  internal::vector<uint32_t> right{};
+  for (const auto i : occupancyOrder(rows)) {
+    const auto inUse = rows.inUseCount(i);
+    const auto low = popcountBelow(rows.row(i), half);
+    const auto high = inUse - low;
+    if (low > high || (low == high && left.size() <= right.size()))
+      left.push_back(i);
+    else
+      right.push_back(i);
+  }
+
+  internal::vector<bool> taken(size, false);
+  size_t comparisons = 0;
+
+  size_t foundCount = 0;
+  for (size_t a = 0; a < left.size() && comparisons < kMaxMesherComparisons; a++) {
+    const size_t i = left[a];
+
+    const auto j = firstMeshable(rows, i, right, 0, taken, comparisons);
+    if (j < 0)
+      continue;
+
+    taken[i] = true;
+    taken[j] = true;
+    meshFound(i, j);
+    foundCount++;
+    if (foundCount > kMaxMeshesPerIteration) {
+      return comparisons;
+    }
+  }
+
+  return comparisons;
+}
+
+// bounded-time approximate maximum matching.  Up to
+// kMaxMatchingCandidates rows are compared all-pairs to build the
+// meshability graph, which is then matched greedily by minimum degree
+// (in the spirit of Karp-Sipser): the unmatched vertex with the fewest
+// remaining options is matched first, to its neighbour with the fewest
+// options.  On small sets of very sparse spans this finds far more
+// meshes than probing a fixed window.
+inline size_t maxMatchingRows(MWC &prng, BitmapMirror &rows, size_t objectCount,
+                              const RowMeshFound &meshFound) noexcept {
+  rows.shuffle(prng);
+
+  const size_t n = rows.size() < kMaxMatchingCandidates ? rows.size() : kMaxMatchingCandidates;
+  if (n < 2)
+    return 0;
+
+  internal::vector<uint32_t> degree(n, 0);
+  internal::vector<std::pair<uint32_t, uint32_t>> edges{};
+  size_t comparisons = 0;
+
+  for (size_t i = 0; i < n; i++) {
+    const auto meshCount = rows.meshCount(i);
+    for (size_t j = i + 1; j < n;) {
+      const Bitmap::word_t *others[kMeshableMaskWidth];
+      size_t idxs[kMeshableMaskWidth];
+      size_t count = 0;
+      for (; j < n && count < kMeshableMaskWidth; j++) {
+        if (meshCount + rows.meshCount(j) > kMaxMeshes)
+          continue;
+        others[count] = rows.bitmap(j);
+        idxs[count] = j;
+        count++;
+      }
+
+      uint32_t mask = count > 0 ? mesh::bitmapsMeshableMask(rows.bitmap(i), others, count) : 0;
+      comparisons += count;
+      while (mask != 0) {
+        const size_t k = idxs[__builtin_ctz(mask)];
+        mask &= mask - 1;
+        edges.emplace_back(i, k);
+        degree[i]++;
+        degree[k]++;
+      }
+    }
+  }
+
+  if (edges.empty())
+    return comparisons;
+
+  // compressed adjacency lists
+  internal::vector<uint32_t> adjStart(n + 1, 0);
+  for (size_t i = 0; i < n; i++) {
+    adjStart[i + 1] = adjStart[i] + degree[i];
+  }
+  internal::vector<uint32_t> adj(adjStart[n]);
+  {
+    internal::vector<uint32_t> fill(adjStart.begin(), adjStart.end() - 1);
+    for (const auto &edge : edges) {
+      adj[fill[edge.first]++] = edge.second;
+      adj[fill[edge.second]++] = edge.first;
+    }
+  }
+
+  internal::vector<bool> matched(n, false);
+  // takes v out of the graph, updating its neighbours' degrees
+  const auto retire = [&](uint32_t v) {
+    matched[v] = true;
+    degree[v] = 0;
+    for (size_t e = adjStart[v]; e < adjStart[v + 1]; e++) {
+      const auto w = adj[e];
+      if (!matched[w])
+        degree[w]--;
+    }
+  };
+
+  size_t foundCount = 0;
+  while (true) {
+    size_t u = n;
+    for (size_t v = 0; v < n; v++) {
+      if (!matched[v] && degree[v] > 0 && (u == n || degree[v] < degree[u]))
+        u = v;
+    }
+    if (u == n)
+      break;
+
+    size_t best = n;
+    for (size_t e = adjStart[u]; e < adjStart[u + 1]; e++) {
+      const auto w = adj[e];
+      if (!matched[w] && (best == n || degree[w] < degree[best]))
+        best = w;
+    }
+    d_assert(best != n);
+
+    retire(u);
+    retire(best);
+
+    meshFound(u, best);
+    foundCount++;
+    if (foundCount > kMaxMeshesPerIteration) {
+      return comparisons;
+    }
+  }
+
+  return comparisons;
+}
+
+// pairs rows through their occupancy signatures (see BitmapMirror)
+// before comparing any bitmaps.  Rows are bucketed by signature, and
+// each row, densest signatures first, is paired with an untaken row
+// from the densest bucket whose signature is disjoint from its own;
+// such pairs are meshable by construction.  Only the rows left over
+// go through (shorter) shifted probing.  On sparse heaps most pairs
+// are found with no bitmapsMeshable calls at all.
+inline size_t signatureRows(MWC &prng, BitmapMirror &rows, size_t objectCount,
+                            const RowMeshFound &meshFound) noexcept {
+  rows.shuffle(prng);
+
+  const size_t size = rows.size();
+  if (size < 2)
+    return 0;
+
+  constexpr size_t kSignatureMask = (1 << BitmapMirror::kSignatureBits) - 1;
+  constexpr size_t kSignatureCount = kSignatureMask + 1;
+
+  // counting sort of row indices by signature; rows of signature s
+  // live in byBucket[bucketStart[s], bucketStart[s + 1]), and those
+  // before next[s] have been taken
+  internal::vector<uint32_t> bucketStart(kSignatureCount + 1, 0);
+  for (size_t i = 0; i < size; i++) {
+    bucketStart[rows.signature(i) + 1]++;
+  }
+  for (size_t s = 0; s < kSignatureCount; s++) {
+    bucketStart[s + 1] += bucketStart[s];
+  }
+  internal::vector<uint32_t> next(bucketStart.begin(), bucketStart.end() - 1);
+  internal::vector<uint32_t> byBucket(size);
+  {
+    internal::vector<uint32_t> fill(next);
+    for (size_t i = 0; i < size; i++) {
+      byBucket[fill[rows.signature(i)]++] = i;
+    }
+  }
+
+  // dense signatures have the fewest disjoint partners, so go first
+  static const auto order = [] {
+    std::array<uint8_t, kSignatureCount> order{};
+    for (size_t s = 0; s < kSignatureCount; s++) {
+      order[s] = s;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [](uint8_t a, uint8_t b) { return __builtin_popcount(a) > __builtin_popcount(b); });
+    return order;
+  }();
+
+  internal::vector<bool> taken(size, false);
+  internal::vector<uint32_t> leftover{};
+  size_t foundCount = 0;
+
+  for (size_t o = 0; o < kSignatureCount; o++) {
+    const size_t s = order[o];
+    const size_t complement = ~s & kSignatureMask;
+
+    while (next[s] < bucketStart[s + 1]) {
+      const auto i = byBucket[next[s]++];
+      if (taken[i])
+        continue;
+      taken[i] = true;
+
+      // walk the submasks of complement, densest first
+      ssize_t partner = -1;
+      for (size_t t = complement;; t = (t - 1) & complement) {
+        while (next[t] < bucketStart[t + 1] && taken[byBucket[next[t]]]) {
+          next[t]++;
+        }
+        if (next[t] < bucketStart[t + 1]) {
+          const auto j = byBucket[next[t]];
+          if (rows.meshCount(i) + rows.meshCount(j) <= kMaxMeshes) {
+            partner = j;
+            break;
+          }
+        }
+        if (t == 0)
+          break;
+      }
+
+      if (partner < 0) {
+        leftover.push_back(i);
+        continue;
+      }
+
+      taken[partner] = true;
+      if (rows.meshCount(partner) > rows.meshCount(i))
+        meshFound(partner, i);
+      else
+        meshFound(i, partner);
+
+      foundCount++;
+      if (foundCount > kMaxMeshesPerIteration) {
+        return 0;
+      }
+    }
+  }
+
+  if (leftover.size() < 2)
+    return 0;
+
+  // row IDs in rest are indices into rows, as the shuffle in
+  // shiftedGroupingRows reorders them
+  BitmapMirror rest{};
+  rest.setObjectCount(objectCount);
+  rest.reserve(leftover.size());
+  for (const auto i : leftover) {
+    rest.push(rows.row(i), MiniHeapID{i}, rows.meshCount(i));
+  }
+
+  return shiftedGroupingRows<16>(prng, rest, objectCount, [&](size_t dst, size_t src) {
+    meshFound(rest.id(dst).value(), rest.id(src).value());
+  });
+}
+
+enum MesherId : size_t {
+  ShiftedGroupingMesher = 0,
+  GreedyMesher,
+  GreedySplittingMesher,
+  MaxMatchingMesher,
+  SignatureMesher,
+  MesherCount,
+};
+
+static constexpr size_t kDefaultMesher = ShiftedGroupingMesher;
+
+struct MesherEntry {
+  const char *name;
+  Mesher mesher;
+};
+
+inline const MesherEntry &mesherEntry(size_t id) {
+  static const MesherEntry entries[MesherCount] = {
+      {"shifted", shiftedGroupingRows<64>},
+      {"greedy", greedyRows},
+      {"greedysplit", greedySplittingRows},
+      {"maxmatch", maxMatchingRows},
+      {"signature", signatureRows},
+  };
+  d_assert(id < MesherCount);
+  return entries[id];
+}
+
+// returns the ID of the mesher registered under name, or -1
+inline ssize_t mesherByName(const char *name) {
+  for (size_t id = 0; id < MesherCount; id++) {
+    if (strcmp(mesherEntry(id).name, name) == 0)
+      return id;
+  }
+  return -1;
+}
+
+// runs mesher over the current meshing candidates of a size
+// class.  The search itself only sees the BitmapMirror snapshot;
+// MiniHeap pointers are resolved just for the pairs it reports.
+inline void meshWith(Mesher mesher, MWC &prng, BinnedTracker &miniheaps,
+                     const function<void(std::pair<MiniHeap *, MiniHeap *> &&)> &meshFound) noexcept {
+  if (miniheaps.partialSize() == 0)
+    return;
+
+  BitmapMirror rows{};
+  miniheaps.meshingCandidates(kOccupancyCutoff, rows);
+  if (rows.size() < 2)
+    return;
+
+  mesher(prng, rows, miniheaps.objectCount(), [&](size_t dst, size_t src) {
+    std::pair<MiniHeap *, MiniHeap *> heaps{GetMiniHeap(rows.id(dst)), GetMiniHeap(rows.id(src))};
+    meshFound(std::move(heaps));
+  });
+}
+
+template <size_t t = 64>
+inline void shiftedGrouping(MWC &prng, BinnedTracker &miniheaps,
+                            const function<void(std::pair<MiniHeap *, MiniHeap *> &&)> &meshFound) noexcept {
+  meshWith(shiftedGroupingRows<t>, prng, miniheaps, meshFound);
 }
 }  // namespace method
 }  // namespace mesh
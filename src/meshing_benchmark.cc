@@ -1,6 +1,10 @@
 // -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil -*-
 // Copyright 2017 University of Massachusetts, Amherst
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <memory>
@@ -15,9 +19,11 @@
 #include "internal.h"
 
 #include "bitmap.h"
+#include "bitmap_mirror.h"
+#include "heap_snapshot.h"
 #include "meshing.h"
 
-using mesh::internal::Bitmap;
+using mesh::BitmapMirror;
 using std::make_unique;
 using std::stoi;
 using std::string;
@@ -50,10 +56,12 @@ public:
         nStrings(static_cast<size_t>(nStrings)),
         method(method) {
     d_assert(length > 0);
+    d_assert(static_cast<size_t>(length) <= BitmapMirror::kWords * 64);
     d_assert(occupancy > 0);
     d_assert(nStrings > 0);
   }
-  vector<Bitmap> bitmaps{};
+  // one row per string; bit i of a row is character i of the string
+  BitmapMirror rows{};
   vector<mesh::internal::string> strings{};
 
   size_t length;  // string length
@@ -61,6 +69,9 @@ public:
   size_t nStrings;
   string method;
 
+  string name{};
+  size_t spanPages{1};
+  // -1 if unknown, e.g. for testcases replayed from heap snapshots
   ssize_t expectedResult{-1};
 };
 
@@ -87,6 +98,7 @@ unique_ptr<MeshTestcase> openTestcase(const char *path) {
   free(fname);
 
   auto testcase = make_unique<MeshTestcase>(stoi(parts[0]), stoi(parts[1]), stoi(parts[2]), parts[3]);
+  testcase->name = bname;
 
   bool loop = true;
   while (loop) {
@@ -124,11 +136,17 @@ unique_ptr<MeshTestcase> openTestcase(const char *path) {
       mesh::internal::string sline{line};
       d_assert(sline.length() == testcase->length);
 
-      testcase->bitmaps.emplace_back(sline);
+      uint64_t bits[BitmapMirror::kWords] = {};
+      for (size_t i = 0; i < sline.length(); i++) {
+        d_assert_msg(sline[i] == '0' || sline[i] == '1', "expected 0 or 1 in bitstring, not %c ('%s')", sline[i], line);
+        if (sline[i] == '1')
+          bits[i / 64] |= 1UL << (i % 64);
+      }
+      if (testcase->rows.empty())
+        testcase->rows.setObjectCount(testcase->length);
+      const auto id = mesh::MiniHeapID{static_cast<uint32_t>(testcase->rows.size())};
+      testcase->rows.push(bits, id, 1);
       testcase->strings.emplace_back(sline);
-
-      d_assert_msg(sline == testcase->bitmaps.back().to_string(sline.length()), "expected roundtrip '%s' == '%s'", line,
-                   testcase->bitmaps.back().to_string().c_str());
     }
     free(line);
   }
@@ -141,47 +159,229 @@ unique_ptr<MeshTestcase> openTestcase(const char *path) {
   return testcase;
 }
 
-bool validate(const unique_ptr<MeshTestcase> &testcase) {
-  ssize_t result = 0;
-  if (testcase->method == "dumb") {
-    // result = mesh::method::simple(testcase->bitmaps);
-    printf("TODO: implement new shifted splitting method here\n");
-    if (result == testcase->expectedResult)
-      return true;
-  } else {
-    printf("ERROR: unimplemented method '%s'\n", testcase->method.c_str());
+// if path is a heap snapshot written on SIGDUMP, appends one testcase
+// per size class to testcases, holding the miniheaps the heap itself
+// would have considered for meshing.  Returns false if path isn't a
+// snapshot.
+bool openSnapshot(const char *path, vector<unique_ptr<MeshTestcase>> &testcases) {
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    fprintf(stderr, "ERROR: couldn't open %s: %s\n", path, strerror(errno));
+    exit(1);
+  }
+
+  mesh::internal::vector<mesh::snapshot::Record> records{};
+  const bool ok = mesh::snapshot::read(fd, records);
+  close(fd);
+  if (!ok)
     return false;
+
+  auto *bname = basename(const_cast<char *>(path));
+  const size_t countBefore = testcases.size();
+
+  for (int sizeClass = 0; sizeClass < mesh::kNumBins; sizeClass++) {
+    BitmapMirror rows{};
+    size_t objectCount = 0;
+    size_t inUseTotal = 0;
+    for (const auto &record : records) {
+      if (record.sizeClass != sizeClass || (record.flags & (mesh::snapshot::Attached | mesh::snapshot::Meshed)))
+        continue;
+
+      size_t inUse = 0;
+      for (size_t w = 0; w < BitmapMirror::kWords; w++) {
+        inUse += __builtin_popcountl(record.bitmap[w]);
+      }
+      // the same filter BinnedTracker::meshingCandidates applies
+      if (inUse == 0 || inUse >= mesh::kOccupancyCutoff * record.objectCount)
+        continue;
+
+      if (rows.empty())
+        rows.setObjectCount(record.objectCount);
+      objectCount = record.objectCount;
+      inUseTotal += inUse;
+      rows.push(record.bitmap, mesh::MiniHeapID{record.id}, record.meshCount);
+    }
+
+    if (rows.size() < 2)
+      continue;
+
+    const auto meanOccupancy = (inUseTotal + rows.size() - 1) / rows.size();
+    auto testcase = make_unique<MeshTestcase>(objectCount, meanOccupancy, rows.size(), "snapshot");
+    testcase->name = string(bname) + ":" + std::to_string(sizeClass);
+    const auto spanBytes = objectCount * mesh::SizeMap::ByteSizeForClass(sizeClass);
+    testcase->spanPages = (spanBytes + mesh::kPageSize - 1) / mesh::kPageSize;
+    for (size_t i = 0; i < rows.size(); i++) {
+      testcase->rows.pushRow(rows, i);
+    }
+    testcases.push_back(std::move(testcase));
   }
 
-  if (result != testcase->expectedResult) {
-    printf("ERROR: unexpected result %zu (expected %zu) for %s method\n", result, testcase->expectedResult,
-           testcase->method.c_str());
+  if (testcases.size() == countBefore) {
+    fprintf(stderr, "WARNING: no meshing candidates in snapshot %s\n", path);
   }
-  return false;
+
+  return true;
+}
+
+struct MesherResult {
+  size_t meshes{0};  // (dst, src) pairs found
+  size_t comparisons{0};
+  double passMicros{0};  // mean wall time of a single pass
+  bool valid{true};
+};
+
+static void copyRows(const BitmapMirror &from, BitmapMirror &to) {
+  to.clear();
+  to.reserve(from.size());
+  for (size_t i = 0; i < from.size(); i++) {
+    to.pushRow(from, i);
+  }
+}
+
+// runs mesher over the testcase iterations times, each time on a fresh
+// copy of its rows.  The meshes found in every pass are checked: each
+// source must be disjoint from everything already meshed into its
+// destination, and no row may be meshed away twice.
+static MesherResult evaluate(const MeshTestcase &testcase, mesh::method::Mesher mesher, size_t iterations,
+                             uint64_t seed) {
+  MesherResult result{};
+
+  MWC prng(seed, seed + 1);
+  BitmapMirror rows{};
+  double totalMicros = 0;
+
+  for (size_t iter = 0; iter < iterations; iter++) {
+    copyRows(testcase.rows, rows);
+
+    vector<std::pair<size_t, size_t>> found{};
+    const auto start = std::chrono::steady_clock::now();
+    const auto comparisons =
+        mesher(prng, rows, testcase.length, [&](size_t dst, size_t src) { found.emplace_back(dst, src); });
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    totalMicros += elapsed.count();
+
+    vector<uint64_t> occupied(rows.size() * BitmapMirror::kWords);
+    for (size_t i = 0; i < rows.size(); i++) {
+      memcpy(&occupied[i * BitmapMirror::kWords], rows.row(i), BitmapMirror::kWords * sizeof(uint64_t));
+    }
+    vector<bool> removed(rows.size(), false);
+    for (const auto &mesh : found) {
+      const auto dst = mesh.first;
+      const auto src = mesh.second;
+      bool ok = dst != src && !removed[dst] && !removed[src];
+      for (size_t w = 0; ok && w < BitmapMirror::kWords; w++) {
+        ok = (occupied[dst * BitmapMirror::kWords + w] & rows.row(src)[w]) == 0;
+        occupied[dst * BitmapMirror::kWords + w] |= rows.row(src)[w];
+      }
+      removed[src] = true;
+      result.valid = result.valid && ok;
+    }
+
+    // report the first pass; passes only differ in their shuffles
+    if (iter == 0) {
+      result.meshes = found.size();
+      result.comparisons = comparisons;
+    }
+  }
+
+  result.passMicros = iterations > 0 ? totalMicros / iterations : 0;
+  return result;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr, "Reads in string dumps or heap snapshots and runs every registered mesher over them.\n\n");
+  fprintf(stderr, "USAGE: %s [--json] [--iterations N] [--seed N] DUMP_FILE...\n\n", argv0);
+  fprintf(stderr, "Dumps are one span per line as a bitstring, followed by a line\n");
+  fprintf(stderr, "'-N' recording the number of meshes the reference method found.\n");
+  fprintf(stderr, "Heap snapshots (written by libmesh on SIGDUMP) are detected\n");
+  fprintf(stderr, "automatically and replayed one size class at a time.\n");
+  fprintf(stderr, "Results are written to stdout as CSV (or a JSON array with --json);\n");
+  fprintf(stderr, "each span in a text dump is a single page, so pages_reclaimed == meshes.\n");
 }
 
 int main(int argc, char *argv[]) {
-  if (argc > 1 && ((strcmp(argv[1], "--help") == 0) || (strcmp(argv[1], "-h") == 0))) {
-    fprintf(stderr, "Reads in string dumps and attempts to mesh.\n\n");
-    fprintf(stderr, "USAGE: %s DUMP_FILE\n", basename(argv[0]));
-    exit(0);
+  bool json = false;
+  size_t iterations = 10;
+  uint64_t seed = 42;
+  vector<const char *> paths{};
+
+  for (auto i = 1; i < argc; ++i) {
+    if ((strcmp(argv[i], "--help") == 0) || (strcmp(argv[i], "-h") == 0)) {
+      usage(basename(argv[0]));
+      exit(0);
+    } else if (strcmp(argv[i], "--json") == 0) {
+      json = true;
+    } else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+      iterations = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      seed = strtoull(argv[++i], nullptr, 10);
+    } else {
+      paths.push_back(argv[i]);
+    }
   }
 
-  if (argc <= 1) {
+  if (paths.empty()) {
     fprintf(stderr, "ERROR: expected at least one filename pointing to a dump.\n");
     exit(1);
   }
 
-  for (auto i = 1; i < argc; ++i) {
-    printf("meshing strings from %s\n", argv[i]);
+  if (json)
+    printf("[\n");
+  else
+    printf("dump,mesher,spans,length,meshes,pages_reclaimed,expected,vs_expected,pass_us,comparisons,pages_per_us\n");
 
-    auto testcase = openTestcase(argv[i]);
+  bool allValid = true;
+  bool first = true;
+  vector<unique_ptr<MeshTestcase>> testcases{};
+  for (const auto path : paths) {
+    if (!openSnapshot(path, testcases)) {
+      testcases.push_back(openTestcase(path));
+    }
+  }
 
-    if (!validate(testcase)) {
-      printf("%s: failed to validate.\n", argv[i]);
-      exit(1);
+  for (const auto &testcase : testcases) {
+    const auto *bname = testcase->name.c_str();
+
+    for (size_t id = 0; id < mesh::method::MesherCount; id++) {
+      const auto &entry = mesh::method::mesherEntry(id);
+      const auto result = evaluate(*testcase, entry.mesher, iterations, seed);
+      allValid = allValid && result.valid;
+      if (!result.valid) {
+        fprintf(stderr, "ERROR: %s produced an invalid mesh on %s\n", entry.name, bname);
+      }
+
+      // left empty (or null) when the optimum is unknown
+      char expected[32] = "";
+      char vsExpected[32] = "";
+      if (testcase->expectedResult >= 0) {
+        snprintf(expected, sizeof(expected), "%zd", testcase->expectedResult);
+        snprintf(vsExpected, sizeof(vsExpected), "%zd",
+                 static_cast<ssize_t>(result.meshes) - testcase->expectedResult);
+      } else if (json) {
+        strcpy(expected, "null");
+        strcpy(vsExpected, "null");
+      }
+      const size_t pages = result.meshes * testcase->spanPages;
+      const double perMicro = result.passMicros > 0 ? pages / result.passMicros : 0;
+
+      if (json) {
+        printf("%s  {\"dump\": \"%s\", \"mesher\": \"%s\", \"spans\": %zu, \"length\": %zu, \"meshes\": %zu, "
+               "\"pages_reclaimed\": %zu, \"expected\": %s, \"vs_expected\": %s, \"pass_us\": %.3f, "
+               "\"comparisons\": %zu, \"pages_per_us\": %.4f}",
+               first ? "" : ",\n", bname, entry.name, testcase->nStrings, testcase->length, result.meshes, pages,
+               expected, vsExpected, result.passMicros, result.comparisons, perMicro);
+      } else {
+        // dump names contain commas, so they are quoted
+        printf("\"%s\",%s,%zu,%zu,%zu,%zu,%s,%s,%.3f,%zu,%.4f\n", bname, entry.name, testcase->nStrings,
+               testcase->length, result.meshes, pages, expected, vsExpected, result.passMicros, result.comparisons,
+               perMicro);
+      }
+      first = false;
     }
   }
 
-  return 0;
+  if (json)
+    printf("\n]\n");
+
+  return allValid ? 0 : 1;
 }
@@ -222,7 +222,7 @@ public:
 
   inline uintptr_t getSpanStart(const void *arenaBegin) const {
     const auto beginval = reinterpret_cast<uintptr_t>(arenaBegin);
-    return beginval + _span.offset * kPageSize;
+    return beginval + _span.byteOffset();
   }
 
   inline bool ATTRIBUTE_ALWAYS_INLINE isEmpty() const {
@@ -280,8 +280,31 @@ public:
     return _nextMiniHeap.hasValue();
   }
 
+  // objects smaller than a page are meshed by copying them into the
+  // destination span.  Objects of a page or more must fill whole
+  // pages, and only the pages they occupy are remapped (see
+  // occupiedPageMask).  Single-object spans have nothing to mesh with.
   inline bool isMeshingCandidate() const {
-    return !isAttached() && objectSize() < kPageSize;
+    return !isAttached() && maxCount() > 1 && (objectSize() < kPageSize || objectSize() % kPageSize == 0);
+  }
+
+  inline bool meshesByPage() const {
+    return objectSize() >= kPageSize;
+  }
+
+  // the pages of our span that hold live objects, one bit per page
+  inline uint64_t occupiedPageMask() const {
+    d_assert(meshesByPage() && objectSize() % kPageSize == 0);
+    d_assert(spanSize() / kPageSize <= 64);
+
+    const size_t objectPages = objectSize() / kPageSize;
+    const uint64_t objectMask = objectPages >= 64 ? ~0UL : (1UL << objectPages) - 1;
+
+    uint64_t mask = 0;
+    for (auto const &off : _bitmap) {
+      mask |= objectMask << (off * objectPages);
+    }
+    return mask;
   }
 
   /// Returns the fraction full (in the range [0, 1]) that this miniheap is.
@@ -376,8 +399,8 @@ public:
     const size_t inUseCount = this->inUseCount();
     const size_t meshCount = this->meshCount();
     mesh::debug("MiniHeap(%p:%5zu): %3zu objects on %2zu pages (inUse: %zu, spans: %zu)\t%p-%p\n", this, objectSize(),
-                maxCount(), heapPages, inUseCount, meshCount, _span.offset * kPageSize,
-                _span.offset * kPageSize + spanSize());
+                maxCount(), heapPages, inUseCount, meshCount, _span.byteOffset(),
+                _span.byteOffset() + spanSize());
     mesh::debug("\t%s\n", _bitmap.to_string(maxCount()).c_str());
   }
 
@@ -385,7 +408,7 @@ public:
   inline uint8_t ATTRIBUTE_ALWAYS_INLINE getUnmeshedOff(const void *arenaBegin, void *ptr) const {
     const auto ptrval = reinterpret_cast<uintptr_t>(ptr);
 
-    uintptr_t span = reinterpret_cast<uintptr_t>(arenaBegin) + _span.offset * kPageSize;
+    uintptr_t span = reinterpret_cast<uintptr_t>(arenaBegin) + _span.byteOffset();
     d_assert(span != 0);
 
     const size_t off = (ptrval - span) * _objectSizeReciprocal;
@@ -422,7 +445,7 @@ protected:
 
     // manually unroll loop once to capture the common case of
     // un-meshed miniheaps
-    uintptr_t spanptr = arenaBegin + _span.offset * kPageSize;
+    uintptr_t spanptr = arenaBegin + _span.byteOffset();
     if (likely(spanptr <= ptrval && ptrval < spanptr + len)) {
       return spanptr;
     }
@@ -442,7 +465,7 @@ protected:
 
       mh = GetMiniHeap(mh->_nextMiniHeap);
 
-      const uintptr_t meshedSpanptr = arenaBegin + mh->span().offset * kPageSize;
+      const uintptr_t meshedSpanptr = arenaBegin + mh->span().byteOffset();
       if (meshedSpanptr <= ptrval && ptrval < meshedSpanptr + len) {
         spanptr = meshedSpanptr;
         break;
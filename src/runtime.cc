@@ -3,6 +3,7 @@
 
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <pthread.h>
 #include <sched.h>
 #include <stdlib.h>
@@ -10,6 +11,8 @@
 #include <sys/types.h>
 
 #ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/signalfd.h>
 #endif
 
@@ -174,6 +177,18 @@ void Runtime::createSignalFd() {
 void Runtime::startBgThread() {
   constexpr int MaxRetries = 20;
 
+  if (_dirtyDecayMs.count() > 0) {
+    _heap.setDirtyDecay(true);
+  }
+
+#ifdef __linux__
+  // hole punching moves off of the freeing threads too
+  _punchFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (_punchFd >= 0) {
+    _heap.setAsyncPunch(_punchFd);
+  }
+#endif
+
   pthread_t bgPthread;
   int retryCount = 0;
   int ret = 0;
@@ -198,7 +213,48 @@ void *Runtime::bgThread(void *arg) {
   // debug("libmesh: background thread started\n");
 
 #ifdef __linux__
+  // wake up once per decay epoch to purge aged dirty pages, in
+  // between punching holes and servicing signals
+  const auto decayEpoch = rt._dirtyDecayMs / kDirtyDecaySteps;
+  const bool decay = decayEpoch.count() > 0;
+  auto nextDecay = std::chrono::steady_clock::now() + decayEpoch;
+
+  struct pollfd pfds[2] = {
+      {rt._signalFd, POLLIN, 0},
+      {rt._punchFd, POLLIN, 0},
+  };
+  const nfds_t nfds = rt._punchFd >= 0 ? 2 : 1;
+
   while (true) {
+    int timeout = -1;
+    if (decay) {
+      const auto now = std::chrono::steady_clock::now();
+      if (now >= nextDecay) {
+        rt._heap.decayDirtyPages();
+        nextDecay = now + decayEpoch;
+      }
+      timeout = std::chrono::duration_cast<std::chrono::milliseconds>(nextDecay - now).count() + 1;
+    }
+
+    const int ready = poll(pfds, nfds, timeout);
+    if (ready < 0 && errno != EINTR) {
+      return nullptr;
+    }
+    if (ready <= 0) {
+      continue;
+    }
+
+    if (nfds > 1 && (pfds[1].revents & POLLIN)) {
+      uint64_t count;
+      while (read(rt._punchFd, &count, sizeof(count)) == sizeof(count)) {
+      }
+      rt._heap.drainPunches();
+    }
+
+    if (!(pfds[0].revents & POLLIN)) {
+      continue;
+    }
+
     struct signalfd_siginfo siginfo;
 
     ssize_t s = read(rt._signalFd, &siginfo, sizeof(struct signalfd_siginfo));
@@ -214,11 +270,7 @@ void *Runtime::bgThread(void *arg) {
 
     if (static_cast<int>(siginfo.ssi_signo) == SIGDUMP) {
       // debug("libmesh: background thread received SIGDUMP, starting dump\n");
-      debug(">>>>>>>>>>\n");
-      rt.heap().dumpStrings();
-      // debug("<<<<<<<<<<\n");
-
-      // debug("<<<<<<<<<<\n");
+      rt.writeSnapshot();
     } else {
       printf("Read unexpected signal\n");
     }
@@ -227,6 +279,34 @@ void *Runtime::bgThread(void *arg) {
   return nullptr;
 }
 
+void Runtime::writeSnapshot() {
+  // the heap lock is only held while records are copied out; the
+  // (potentially slow) write happens after it has been released
+  internal::vector<snapshot::Record> records{};
+  _heap.snapshot(records);
+
+  char defaultPath[64];
+  const char *path = getenv("MESH_SNAPSHOT_PATH");
+  if (path == nullptr) {
+    snprintf(defaultPath, sizeof(defaultPath), "/tmp/mesh-snapshot.%d.%zu.bin", getpid(), _snapshotCount++);
+    path = defaultPath;
+  }
+
+  const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    debug("mesh: couldn't open snapshot file %s: %d\n", path, errno);
+    return;
+  }
+
+  if (!snapshot::write(fd, records.data(), records.size())) {
+    debug("mesh: writing snapshot to %s failed: %d\n", path, errno);
+  } else {
+    debug("mesh: wrote %zu miniheaps to %s\n", records.size(), path);
+  }
+
+  close(fd);
+}
+
 void Runtime::lock() {
   _mutex.lock();
 }
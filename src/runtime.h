@@ -50,6 +50,14 @@ public:
     _heap.setMeshPeriodNs(period);
   }
 
+  // how long dirty pages may sit unused before the background thread
+  // returns them to the OS.  Zero disables decay, leaving dirty pages
+  // to be released by meshing or the dirty page threshold.  Must be
+  // called before startBgThread.
+  void setDirtyDecayMs(std::chrono::milliseconds decay) {
+    _dirtyDecayMs = decay;
+  }
+
 #ifdef __linux__
   int epollWait(int __epfd, struct epoll_event *__events, int __maxevents, int __timeout);
   int epollPwait(int __epfd, struct epoll_event *__events, int __maxevents, int __timeout, const __sigset_t *__ss);
@@ -70,6 +78,10 @@ public:
 
   static void *startThread(StartThreadArgs *threadArgs);
 
+  // writes a binary heap snapshot (see heap_snapshot.h) to
+  // $MESH_SNAPSHOT_PATH, or to a per-process file under /tmp
+  void writeSnapshot();
+
   // so we can call from the libmesh init function
   void createSignalFd();
   void installSegfaultHandler();
@@ -98,7 +110,10 @@ private:
   GlobalHeap _heap{};
   mutex _mutex{};
   int _signalFd{-2};
+  int _punchFd{-1};  // eventfd the arena signals when it has holes to punch
   pid_t _pid{};
+  size_t _snapshotCount{0};
+  std::chrono::milliseconds _dirtyDecayMs{kDirtyDecayTime};
 };
 
 // get a reference to the Runtime singleton
@@ -5,6 +5,7 @@
 #ifndef MESH__SHUFFLE_VECTOR_H
 #define MESH__SHUFFLE_VECTOR_H
 
+#include <algorithm>
 #include <iterator>
 #include <random>
 #include <utility>
@@ -155,7 +156,9 @@ public:
     }
 
     if (addedCapacity > 0) {
-      if (kEnableShuffleOnInit) {
+      if (kEnableSteeredPlacement) {
+        steer();
+      } else if (kEnableShuffleOnInit) {
         internal::mwcShuffle(&_list[_off], &_list[_maxCount], _prng);
       }
       return true;
@@ -164,6 +167,29 @@ public:
     return false;
   }
 
+  // whether entry lies in the half of its miniheap's offsets that
+  // the miniheap prefers: the lower half for even miniheap IDs, the
+  // upper half for odd ones
+  inline bool isPreferred(sv::Entry entry) const {
+    const auto mh = _attachedMiniheaps[entry.miniheapOffset()];
+    const bool upperHalf = entry.bit() >= mh->maxCount() / 2;
+    return upperHalf == (GetMiniHeapID(mh).value() & 1);
+  }
+
+  // orders the list so that preferred offsets are allocated before
+  // the rest.  While occupancy stays under half, two miniheaps of
+  // opposite ID parity can then always be meshed.  Each half is still
+  // shuffled, so placement within it stays randomized.
+  inline void steer() {
+    sv::Entry *begin = &_list[_off];
+    sv::Entry *end = &_list[_maxCount];
+    sv::Entry *mid = std::partition(begin, end, [this](sv::Entry entry) { return isPreferred(entry); });
+    if (kEnableShuffleOnInit) {
+      internal::mwcShuffle(begin, mid, _prng);
+      internal::mwcShuffle(mid, end, _prng);
+    }
+  }
+
   // number of items in the list
   inline uint32_t ATTRIBUTE_ALWAYS_INLINE length() const {
     return _maxCount - _off;
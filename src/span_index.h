@@ -0,0 +1,130 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil -*-
+// Copyright 2018 Bobby Powers
+
+#pragma once
+#ifndef MESH__SPAN_INDEX_H
+#define MESH__SPAN_INDEX_H
+
+#include "internal.h"
+
+#include "bitmap.h"
+
+namespace mesh {
+
+// One kind (clean or dirty) of free span in the arena, indexed by
+// length.  Spans shorter than kSpanClassCount pages live in one
+// vector per length, with a bitmap of the non-empty lengths so that
+// the shortest one that fits is a find-first-set away.  Longer spans
+// live in a set ordered by (length, offset), where the best fit is a
+// lower_bound.
+class SpanIndex {
+private:
+  DISALLOW_COPY_AND_ASSIGN(SpanIndex);
+
+  static constexpr Length kLargeClass = kSpanClassCount - 1;
+
+public:
+  SpanIndex() {
+  }
+
+  inline void push(const Span &span) {
+    d_assert(!span.empty());
+    const auto spanClass = span.spanClass();
+    if (spanClass == kLargeClass) {
+      _large.emplace(span.length, span.offset);
+    } else {
+      _bins[spanClass].push_back(span);
+      _nonEmpty.tryToSet(spanClass);
+    }
+    _count++;
+  }
+
+  // removes a span previously pushed
+  void remove(const Span &span) {
+    const auto spanClass = span.spanClass();
+    if (spanClass == kLargeClass) {
+      const auto erased = _large.erase(std::make_pair(span.length, span.offset));
+      hard_assert(erased == 1);
+    } else {
+      auto &bin = _bins[spanClass];
+      size_t i = 0;
+      while (i < bin.size() && bin[i].offset != span.offset) {
+        i++;
+      }
+      hard_assert(i < bin.size());
+      bin[i] = bin.back();
+      bin.pop_back();
+      if (bin.empty()) {
+        _nonEmpty.unset(spanClass);
+      }
+    }
+    _count--;
+  }
+
+  // removes the shortest span of at least minLength pages (most
+  // recently pushed first among equals) into result
+  bool popFit(Length minLength, Span &result) {
+    d_assert(minLength > 0);
+
+    if (minLength <= kLargeClass) {
+      const auto spanClass = _nonEmpty.lowestSetBitAt(minLength - 1);
+      if (spanClass < kLargeClass) {
+        auto &bin = _bins[spanClass];
+        result = bin.back();
+        bin.pop_back();
+        if (bin.empty()) {
+          _nonEmpty.unset(spanClass);
+        }
+        _count--;
+        return true;
+      }
+    }
+
+    const auto it = _large.lower_bound(std::make_pair(minLength, static_cast<Offset>(0)));
+    if (it == _large.end()) {
+      return false;
+    }
+    result = Span(it->second, it->first);
+    _large.erase(it);
+    _count--;
+    return true;
+  }
+
+  inline size_t size() const {
+    return _count;
+  }
+
+  inline bool empty() const {
+    return _count == 0;
+  }
+
+  void clear() {
+    for (auto const &spanClass : _nonEmpty) {
+      _bins[spanClass].clear();
+      _nonEmpty.unset(spanClass);
+    }
+    _large.clear();
+    _count = 0;
+  }
+
+  template <typename Func>
+  void forEach(const Func func) const {
+    for (auto const &spanClass : _nonEmpty) {
+      for (auto const &span : _bins[spanClass]) {
+        func(span);
+      }
+    }
+    for (auto const &entry : _large) {
+      func(Span(entry.second, entry.first));
+    }
+  }
+
+private:
+  internal::vector<Span> _bins[kLargeClass]{};  // bin i holds spans of i + 1 pages
+  internal::RelaxedFixedBitmap _nonEmpty{kLargeClass};
+  internal::set<std::pair<Length, Offset>> _large{};
+  size_t _count{0};
+};
+}  // namespace mesh
+
+#endif  // MESH__SPAN_INDEX_H
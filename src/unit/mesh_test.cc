@@ -141,3 +141,255 @@ TEST(MeshTest, TryMesh) {
 TEST(MeshTest, TryMeshInverse) {
   meshTest(true);
 }
+
+TEST(MeshTest, GroupMesh) {
+  if (!kMeshingEnabled) {
+    GTEST_SKIP();
+  }
+
+  const auto tid = gettid();
+  GlobalHeap &gheap = runtime().heap();
+
+  // disable automatic meshing for this test
+  gheap.setMeshPeriodNs(std::chrono::nanoseconds{0});
+
+  ASSERT_EQ(gheap.getAllocatedMiniheapCount(), 0UL);
+
+  constexpr size_t GroupSize = 3;
+  MiniHeap *mhs[GroupSize];
+  char *strs[GroupSize];
+  char *vals[GroupSize];
+
+  FixedArray<MiniHeap, 1> array{};
+  for (size_t i = 0; i < GroupSize; i++) {
+    gheap.allocSmallMiniheaps(SizeMap::SizeClass(StrLen), StrLen, array, tid);
+    mhs[i] = array[0];
+    array.clear();
+  }
+
+  ASSERT_EQ(gheap.getAllocatedMiniheapCount(), GroupSize);
+
+  for (size_t i = 0; i < GroupSize; i++) {
+    // pairwise disjoint offsets, so all three can share one span
+    strs[i] = reinterpret_cast<char *>(mhs[i]->mallocAt(gheap.arenaBegin(), i * 5));
+    ASSERT_TRUE(strs[i] != nullptr);
+    memset(strs[i], 'A' + i, StrLen);
+    strs[i][StrLen - 1] = 0;
+    vals[i] = strdup(strs[i]);
+
+    // detach the miniheap, and move it into a partial bin by freeing
+    // a second object through the global heap
+    void *extra = mhs[i]->mallocAt(gheap.arenaBegin(), ObjCount - 1);
+    mhs[i]->unsetAttached();
+    gheap.free(extra);
+    ASSERT_TRUE(mhs[i]->isMeshingCandidate());
+  }
+
+  ASSERT_EQ(gheap.meshingCandidates(mhs[0]->sizeClass()).size(), GroupSize);
+
+  note("ABOUT TO MESH");
+  size_t oldVal = 0;
+  size_t oldLen = sizeof(oldVal);
+  gheap.mallctl("mesh.compact", &oldVal, &oldLen, nullptr, 0);
+  note("DONE MESHING");
+
+  // all three spans should have been collapsed in a single pass
+  MiniHeap *mh = gheap.miniheapForLocked(strs[0]);
+  ASSERT_EQ(mh->meshCount(), GroupSize);
+  ASSERT_EQ(mh->inUseCount(), GroupSize);
+  for (size_t i = 0; i < GroupSize; i++) {
+    ASSERT_EQ(gheap.miniheapForLocked(strs[i]), mh);
+    ASSERT_STREQ(strs[i], vals[i]);
+  }
+
+  for (size_t i = 0; i < GroupSize; i++) {
+    gheap.free(strs[i]);
+    ::free(vals[i]);
+  }
+  ASSERT_TRUE(mh->isEmpty());
+
+  gheap.freeMiniheap(mh);
+  gheap.scavenge(true);
+
+  ASSERT_EQ(gheap.getAllocatedMiniheapCount(), 0UL);
+}
+
+TEST(MeshTest, PageSizedMesh) {
+  if (!kMeshingEnabled) {
+    GTEST_SKIP();
+  }
+
+  constexpr size_t ObjSize = 2 * kPageSize;
+
+  const auto tid = gettid();
+  GlobalHeap &gheap = runtime().heap();
+
+  // disable automatic meshing for this test
+  gheap.setMeshPeriodNs(std::chrono::nanoseconds{0});
+
+  ASSERT_EQ(gheap.getAllocatedMiniheapCount(), 0UL);
+
+  FixedArray<MiniHeap, 1> array{};
+  gheap.allocSmallMiniheaps(SizeMap::SizeClass(ObjSize), ObjSize, array, tid);
+  MiniHeap *mh1 = array[0];
+  array.clear();
+  gheap.allocSmallMiniheaps(SizeMap::SizeClass(ObjSize), ObjSize, array, tid);
+  MiniHeap *mh2 = array[0];
+  array.clear();
+
+  const size_t objCount = mh1->maxCount();
+  ASSERT_GT(objCount, 3UL);
+
+  char *s1 = reinterpret_cast<char *>(mh1->mallocAt(gheap.arenaBegin(), 0));
+  char *s2 = reinterpret_cast<char *>(mh2->mallocAt(gheap.arenaBegin(), objCount - 1));
+  memset(s1, 'A', ObjSize);
+  memset(s2, 'Z', ObjSize);
+
+  mh1->unsetAttached();
+  mh2->unsetAttached();
+  ASSERT_TRUE(mh1->isMeshingCandidate());
+  ASSERT_TRUE(mh2->isMeshingCandidate());
+  ASSERT_EQ(mh2->occupiedPageMask(), 3UL << ((objCount - 1) * 2));
+
+  note("ABOUT TO MESH");
+  gheap.meshLocked(mh1, mh2);
+  note("DONE MESHING");
+
+  ASSERT_EQ(mh1->meshCount(), 2);
+  ASSERT_EQ(mh1->inUseCount(), 2UL);
+  ASSERT_EQ(s1[ObjSize - 1], 'A');
+  ASSERT_EQ(s2[0], 'Z');
+  ASSERT_EQ(s2[ObjSize - 1], 'Z');
+
+  // the pages holding s2 alias their counterparts in mh1's span
+  char *s3 = s1 + (objCount - 1) * ObjSize;
+  s2[kPageSize] = 'b';
+  ASSERT_EQ(s3[kPageSize], 'b');
+
+  // but pages that held nothing in mh2 were not remapped
+  char *s4 = reinterpret_cast<char *>(mh1->mallocAt(gheap.arenaBegin(), 1));
+  memset(s4, 'C', ObjSize);
+  ASSERT_EQ((s2 - (objCount - 2) * ObjSize)[0], 0);
+
+  gheap.free(s1);
+  gheap.free(s2);
+  gheap.free(s4);
+  ASSERT_TRUE(mh1->isEmpty());
+
+  gheap.freeMiniheap(mh1);
+  gheap.scavenge(true);
+
+  ASSERT_EQ(gheap.getAllocatedMiniheapCount(), 0UL);
+}
+
+TEST(MeshTest, MirrorTracksFrees) {
+  if (!kMeshingEnabled) {
+    GTEST_SKIP();
+  }
+
+  const auto tid = gettid();
+  GlobalHeap &gheap = runtime().heap();
+
+  // disable automatic meshing for this test
+  gheap.setMeshPeriodNs(std::chrono::nanoseconds{0});
+
+  ASSERT_EQ(gheap.getAllocatedMiniheapCount(), 0UL);
+
+  FixedArray<MiniHeap, 1> array{};
+  gheap.allocSmallMiniheaps(SizeMap::SizeClass(StrLen), StrLen, array, tid);
+  MiniHeap *mh1 = array[0];
+  array.clear();
+  gheap.allocSmallMiniheaps(SizeMap::SizeClass(StrLen), StrLen, array, tid);
+  MiniHeap *mh2 = array[0];
+  array.clear();
+
+  // both miniheaps have offset 1 in use, so they start out unmeshable
+  char *s1 = reinterpret_cast<char *>(mh1->mallocAt(gheap.arenaBegin(), 0));
+  char *blocker = reinterpret_cast<char *>(mh1->mallocAt(gheap.arenaBegin(), 1));
+  char *s2 = reinterpret_cast<char *>(mh2->mallocAt(gheap.arenaBegin(), 1));
+  memset(s1, 'A', StrLen);
+  s1[StrLen - 1] = 0;
+  memset(s2, 'B', StrLen);
+  s2[StrLen - 1] = 0;
+
+  // move both into a partial bin
+  MiniHeap *mhs[2] = {mh1, mh2};
+  for (auto mh : mhs) {
+    void *extra = mh->mallocAt(gheap.arenaBegin(), ObjCount - 1);
+    mh->unsetAttached();
+    gheap.free(extra);
+    ASSERT_TRUE(mh->isMeshingCandidate());
+  }
+
+  // this free leaves mh1 in the same bin; the mirrored bitmap used by
+  // the mesh search must still see it
+  gheap.free(blocker);
+  ASSERT_EQ(mh1->inUseCount(), 1UL);
+
+  size_t oldVal = 0;
+  size_t oldLen = sizeof(oldVal);
+  gheap.mallctl("mesh.compact", &oldVal, &oldLen, nullptr, 0);
+
+  MiniHeap *mh = gheap.miniheapForLocked(s1);
+  ASSERT_EQ(gheap.miniheapForLocked(s2), mh);
+  ASSERT_EQ(mh->meshCount(), 2UL);
+  ASSERT_EQ(s1[0], 'A');
+  ASSERT_EQ(s2[0], 'B');
+
+  gheap.free(s1);
+  gheap.free(s2);
+  ASSERT_TRUE(mh->isEmpty());
+
+  gheap.freeMiniheap(mh);
+  gheap.scavenge(true);
+
+  ASSERT_EQ(gheap.getAllocatedMiniheapCount(), 0UL);
+}
+
+TEST(MeshTest, HeapSnapshot) {
+  const auto tid = gettid();
+  GlobalHeap &gheap = runtime().heap();
+
+  ASSERT_EQ(gheap.getAllocatedMiniheapCount(), 0UL);
+
+  FixedArray<MiniHeap, 1> array{};
+  gheap.allocSmallMiniheaps(SizeMap::SizeClass(StrLen), StrLen, array, tid);
+  MiniHeap *mh = array[0];
+  array.clear();
+
+  void *ptr = mh->mallocAt(gheap.arenaBegin(), 3);
+
+  internal::vector<snapshot::Record> records{};
+  gheap.snapshot(records);
+  ASSERT_EQ(records.size(), 1UL);
+
+  const auto &record = records[0];
+  ASSERT_EQ(record.id, GetMiniHeapID(mh).value());
+  ASSERT_EQ(record.chainHead, record.id);
+  ASSERT_EQ(record.sizeClass, mh->sizeClass());
+  ASSERT_EQ(record.objectCount, mh->maxCount());
+  ASSERT_EQ(record.meshCount, 1);
+  ASSERT_EQ(record.flags, snapshot::Attached);
+  ASSERT_EQ(record.bitmap[0], 1UL << 3);
+
+  // round-trip through a file
+  char path[] = "/tmp/mesh-snapshot-test.XXXXXX";
+  const int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  unlink(path);
+  ASSERT_TRUE(snapshot::write(fd, records.data(), records.size()));
+  ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+
+  internal::vector<snapshot::Record> readBack{};
+  ASSERT_TRUE(snapshot::read(fd, readBack));
+  close(fd);
+  ASSERT_EQ(readBack.size(), records.size());
+  ASSERT_EQ(memcmp(readBack.data(), records.data(), records.size() * sizeof(snapshot::Record)), 0);
+
+  mh->unsetAttached();
+  gheap.free(ptr);
+  gheap.flushAllBins();
+  gheap.scavenge(true);
+
+  ASSERT_EQ(gheap.getAllocatedMiniheapCount(), 0UL);
+}
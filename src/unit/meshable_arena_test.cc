@@ -0,0 +1,274 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil -*-
+// Copyright 2018 Bobby Powers
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <map>
+#include <random>
+
+#include "gtest/gtest.h"
+
+#include "internal.h"
+#include "runtime.h"
+#include "span_index.h"
+
+using namespace mesh;
+
+TEST(MeshableArenaTest, SpanIndexBestFit) {
+  SpanIndex spans{};
+  Span span(0, 0);
+
+  ASSERT_FALSE(spans.popFit(1, span));
+
+  spans.push(Span(100, 3));
+  spans.push(Span(200, 7));
+  spans.push(Span(1000, 300));
+  spans.push(Span(2000, 1000));
+  spans.push(Span(5000, 400));
+  ASSERT_EQ(spans.size(), 5UL);
+
+  // the shortest span that fits, whether short or long
+  ASSERT_TRUE(spans.popFit(4, span));
+  ASSERT_EQ(span.offset, 200U);
+  ASSERT_EQ(span.length, 7U);
+  ASSERT_TRUE(spans.popFit(350, span));
+  ASSERT_EQ(span.offset, 5000U);
+  ASSERT_EQ(span.length, 400U);
+  ASSERT_TRUE(spans.popFit(8, span));
+  ASSERT_EQ(span.offset, 1000U);
+  ASSERT_EQ(span.length, 300U);
+  ASSERT_FALSE(spans.popFit(1001, span));
+
+  size_t pages = 0;
+  spans.forEach([&](const Span &s) { pages += s.length; });
+  ASSERT_EQ(pages, 1003UL);
+
+  spans.clear();
+  ASSERT_TRUE(spans.empty());
+  ASSERT_FALSE(spans.popFit(1, span));
+}
+
+TEST(MeshableArenaTest, AlignedPageAlloc) {
+  GlobalHeap &gheap = runtime().heap();
+  MeshableArena &arena = gheap;
+
+  for (size_t alignment : {2, 16, 64}) {
+    Span span(0, 0);
+    char *ptr = arena.pageAlloc(span, 3, alignment);
+    ASSERT_TRUE(ptr != nullptr);
+    ASSERT_EQ(span.length, 3UL);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(ptr) % (alignment * kPageSize), 0UL);
+    arena.free(ptr, span.byteLength(), internal::PageType::Dirty);
+  }
+  gheap.scavenge(true);
+}
+
+TEST(MeshableArenaTest, FreeCoalescesDirtySpans) {
+  GlobalHeap &gheap = runtime().heap();
+  MeshableArena &arena = gheap;
+  gheap.scavenge(true);
+
+  constexpr size_t SpanCount = 4;
+  Span spans[SpanCount] = {Span(0, 0), Span(0, 0), Span(0, 0), Span(0, 0)};
+  for (size_t i = 0; i < SpanCount; i++) {
+    ASSERT_TRUE(arena.pageAlloc(spans[i], 2) != nullptr);
+    if (i > 0) {
+      ASSERT_EQ(spans[i].offset, spans[i - 1].offset + 2);
+    }
+  }
+
+  // free out of order, so each free has to merge on both sides
+  for (size_t i : {0, 2, 3, 1}) {
+    arena.free(gheap.arenaBegin() + spans[i].byteOffset(), spans[i].byteLength(), internal::PageType::Dirty);
+  }
+
+  // the four dirty spans now satisfy a single larger request
+  Span span(0, 0);
+  ASSERT_TRUE(arena.pageAlloc(span, 2 * SpanCount) != nullptr);
+  ASSERT_EQ(span.offset, spans[0].offset);
+  arena.free(gheap.arenaBegin() + span.byteOffset(), span.byteLength(), internal::PageType::Dirty);
+  gheap.scavenge(true);
+}
+
+// randomly allocates and frees spans, scavenging along the way, and
+// checks that no page is ever handed out twice while free spans are
+// merged and split.
+TEST(MeshableArenaTest, ScavengeNeverReusesLivePages) {
+  GlobalHeap &gheap = runtime().heap();
+  MeshableArena &arena = gheap;
+
+  std::mt19937 prng(0);
+  std::uniform_int_distribution<size_t> pageCount(1, 12);
+  std::uniform_int_distribution<size_t> op(0, 9);
+
+  std::map<Offset, Span> live{};
+  const auto overlapsLive = [&](const Span &span) {
+    auto it = live.upper_bound(span.offset);
+    if (it != live.end() && it->second.offset < span.offset + span.length)
+      return true;
+    if (it != live.begin()) {
+      --it;
+      if (it->second.offset + it->second.length > span.offset)
+        return true;
+    }
+    return false;
+  };
+
+  for (size_t i = 0; i < 4000; i++) {
+    const auto choice = op(prng);
+    if (choice < 5 || live.empty()) {
+      Span span(0, 0);
+      char *ptr = arena.pageAlloc(span, pageCount(prng));
+      ASSERT_TRUE(ptr != nullptr);
+      ASSERT_FALSE(overlapsLive(span));
+      ptr[0] = 1;
+      live.emplace(span.offset, span);
+    } else if (choice < 9) {
+      std::uniform_int_distribution<size_t> pick(0, live.size() - 1);
+      auto it = live.begin();
+      std::advance(it, pick(prng));
+      const Span span = it->second;
+      live.erase(it);
+      arena.free(gheap.arenaBegin() + span.byteOffset(), span.byteLength(), internal::PageType::Dirty);
+    } else {
+      gheap.scavenge(true);
+    }
+  }
+
+  for (auto const &entry : live) {
+    const Span &span = entry.second;
+    arena.free(gheap.arenaBegin() + span.byteOffset(), span.byteLength(), internal::PageType::Dirty);
+  }
+  gheap.scavenge(true);
+
+  // everything was coalesced back, so a large request fits without
+  // overlapping anything
+  Span span(0, 0);
+  ASSERT_TRUE(arena.pageAlloc(span, 64) != nullptr);
+  arena.free(gheap.arenaBegin() + span.byteOffset(), span.byteLength(), internal::PageType::Dirty);
+  gheap.scavenge(true);
+}
+
+TEST(MeshableArenaTest, DirtyPagesDecayGradually) {
+  GlobalHeap &gheap = runtime().heap();
+  MeshableArena &arena = gheap;
+  gheap.scavenge(true);
+  gheap.setDirtyDecay(true);
+
+  // single-page frees, so that each can be purged on its own
+  constexpr size_t PageCount = 64;
+  internal::vector<Span> spans(PageCount, Span(0, 0));
+  for (size_t i = 0; i < PageCount; i++) {
+    char *ptr = arena.pageAlloc(spans[i], 1);
+    ASSERT_TRUE(ptr != nullptr);
+    ptr[0] = 1;
+  }
+  for (size_t i = 0; i < PageCount; i++) {
+    arena.free(gheap.arenaBegin() + spans[i].byteOffset(), kPageSize, internal::PageType::Dirty);
+  }
+  ASSERT_EQ(arena.dirtyPageCount(), PageCount);
+
+  // recently freed pages stay dirty for cheap reuse
+  gheap.decayDirtyPages();
+  ASSERT_EQ(arena.dirtyPageCount(), PageCount);
+
+  size_t last = PageCount;
+  bool partial = false;
+  for (size_t i = 1; i < kDirtyDecaySteps; i++) {
+    gheap.decayDirtyPages();
+    ASSERT_LE(arena.dirtyPageCount(), last);
+    last = arena.dirtyPageCount();
+    partial = partial || (0 < last && last < PageCount);
+  }
+  ASSERT_TRUE(partial);
+
+  // and every page is gone once the decay time has passed
+  ASSERT_EQ(arena.dirtyPageCount(), 0UL);
+
+  gheap.setDirtyDecay(false);
+  gheap.scavenge(true);
+}
+
+TEST(MeshableArenaTest, AsyncPunchesCancelledOnReuse) {
+  GlobalHeap &gheap = runtime().heap();
+  MeshableArena &arena = gheap;
+  gheap.scavenge(true);
+
+  const int notifyFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  ASSERT_GE(notifyFd, 0);
+  gheap.setAsyncPunch(notifyFd);
+
+  constexpr size_t PageCount = 4;
+  const auto fill = [](char *ptr, char c) { memset(ptr, c, PageCount * kPageSize); };
+  const auto filled = [](const char *ptr, char c) {
+    for (size_t i = 0; i < PageCount * kPageSize; i++) {
+      if (ptr[i] != c)
+        return false;
+    }
+    return true;
+  };
+
+  Span span(0, 0);
+  char *ptr = arena.pageAlloc(span, PageCount);
+  ASSERT_TRUE(ptr != nullptr);
+  fill(ptr, 'a');
+  arena.free(ptr, span.byteLength(), internal::PageType::Dirty);
+  gheap.scavenge(true);
+
+  // the release queued a punch (and said so) rather than doing it
+  uint64_t count = 0;
+  ASSERT_EQ(read(notifyFd, &count, sizeof(count)), static_cast<ssize_t>(sizeof(count)));
+  ASSERT_TRUE(filled(ptr, 'a'));
+  gheap.drainPunches();
+  ASSERT_TRUE(filled(ptr, 0));
+
+  // reusing the pages before the punch lands cancels it
+  ASSERT_EQ(arena.pageAlloc(span, PageCount), ptr);
+  fill(ptr, 'a');
+  arena.free(ptr, span.byteLength(), internal::PageType::Dirty);
+  gheap.scavenge(true);
+  Span reused(0, 0);
+  char *reusedPtr = arena.pageAlloc(reused, PageCount);
+  ASSERT_EQ(reusedPtr, ptr);
+  fill(reusedPtr, 'b');
+  gheap.drainPunches();
+  ASSERT_TRUE(filled(reusedPtr, 'b'));
+
+  arena.free(reusedPtr, reused.byteLength(), internal::PageType::Dirty);
+  gheap.setAsyncPunch(-1);
+  gheap.scavenge(true);
+  close(notifyFd);
+}
+
+TEST(MeshableArenaTest, ChainsArenas) {
+  GlobalHeap &gheap = runtime().heap();
+  MeshableArena &arena = gheap;
+  gheap.scavenge(true);
+
+  // two of these can't share an arena, so the second one forces a
+  // new arena to be chained on
+  const size_t pageCount = MeshableArena::kArenaPageCount * 3 / 4;
+  const size_t arenaCount = arena.arenaCount();
+  Span spans[2] = {Span(0, 0), Span(0, 0)};
+  for (auto &span : spans) {
+    char *ptr = arena.pageAlloc(span, pageCount);
+    ASSERT_TRUE(ptr != nullptr);
+    ASSERT_TRUE(arena.contains(ptr + span.byteLength() - 1));
+    const size_t first = span.offset / MeshableArena::kArenaPageCount;
+    const size_t last = (span.offset + span.length - 1) / MeshableArena::kArenaPageCount;
+    ASSERT_EQ(first, last);
+
+    ptr[0] = 'a';
+    ptr[span.byteLength() - 1] = 'z';
+    ASSERT_EQ(ptr[0], 'a');
+    ASSERT_EQ(ptr[span.byteLength() - 1], 'z');
+  }
+  ASSERT_GT(arena.arenaCount(), arenaCount);
+  ASSERT_NE(spans[0].offset / MeshableArena::kArenaPageCount, spans[1].offset / MeshableArena::kArenaPageCount);
+
+  for (auto &span : spans) {
+    arena.free(gheap.arenaBegin() + span.byteOffset(), span.byteLength(), internal::PageType::Dirty);
+  }
+  gheap.scavenge(true);
+}
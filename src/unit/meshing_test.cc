@@ -0,0 +1,186 @@
+// -*- mode: c++; c-basic-offset: 2; indent-tabs-mode: nil -*-
+// Copyright 2018 Bobby Powers
+
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+
+#include "gtest/gtest.h"
+
+#include "internal.h"
+#include "meshing.h"
+
+using namespace mesh;
+
+static void checkMaskKernel(internal::MeshableMaskFn kernel) {
+  MWC prng(internal::seed(), internal::seed());
+
+  for (size_t iter = 0; iter < 1000; iter++) {
+    internal::Bitmap left(256);
+    internal::Bitmap right[kMeshableMaskWidth]{internal::Bitmap(256), internal::Bitmap(256), internal::Bitmap(256),
+                                               internal::Bitmap(256), internal::Bitmap(256), internal::Bitmap(256),
+                                               internal::Bitmap(256), internal::Bitmap(256)};
+    const internal::Bitmap::word_t *others[kMeshableMaskWidth];
+    for (size_t i = 0; i < kMeshableMaskWidth; i++) {
+      others[i] = right[i].bits();
+    }
+
+    // sparse bitmaps, so that roughly half of the pairs are meshable
+    for (size_t k = 0; k < 6; k++) {
+      left.tryToSet(prng.inRange(0, 255));
+    }
+    for (size_t i = 0; i < kMeshableMaskWidth; i++) {
+      for (size_t k = 0; k < 6; k++) {
+        right[i].tryToSet(prng.inRange(0, 255));
+      }
+    }
+
+    for (size_t n = 0; n <= kMeshableMaskWidth; n++) {
+      const auto expected = internal::meshableMaskScalar(left.bits(), others, n);
+      ASSERT_EQ(expected, kernel(left.bits(), others, n));
+      ASSERT_EQ(expected, bitmapsMeshableMask(left.bits(), others, n));
+      for (size_t i = 0; i < n; i++) {
+        ASSERT_EQ(((expected >> i) & 1) == 1, bitmapsMeshable(left.bits(), others[i], 32));
+      }
+    }
+  }
+}
+
+TEST(MeshingTest, MeshableMaskScalar) {
+  checkMaskKernel(internal::meshableMaskScalar);
+}
+
+#if defined(__x86_64__)
+TEST(MeshingTest, MeshableMaskAVX2) {
+  if (!__builtin_cpu_supports("avx2")) {
+    return;
+  }
+  checkMaskKernel(internal::meshableMaskAVX2);
+}
+
+TEST(MeshingTest, MeshableMaskAVX512) {
+  if (!__builtin_cpu_supports("avx512f")) {
+    return;
+  }
+  checkMaskKernel(internal::meshableMaskAVX512);
+}
+#endif
+
+// runs mesher over rows, checking that every group it reports is
+// pairwise disjoint and that no row is meshed away twice.  Returns
+// the number of (dst, src) pairs found.
+static size_t checkMesher(method::Mesher mesher, BitmapMirror &rows, size_t objectCount) {
+  MWC prng(internal::seed(), internal::seed());
+
+  internal::vector<std::pair<size_t, size_t>> found{};
+  mesher(prng, rows, objectCount, [&](size_t dst, size_t src) { found.emplace_back(dst, src); });
+
+  internal::vector<bool> removed(rows.size(), false);
+  for (size_t i = 0; i < found.size(); i++) {
+    const auto dst = found[i].first;
+    const auto src = found[i].second;
+    EXPECT_NE(dst, src);
+    EXPECT_FALSE(removed[src]);
+    EXPECT_FALSE(removed[dst]);
+    removed[src] = true;
+
+    // every member of a group must be disjoint from the others
+    for (size_t j = i; j > 0 && found[j - 1].first == dst; j--) {
+      EXPECT_TRUE(bitmapsMeshable(rows.bitmap(found[j - 1].second), rows.bitmap(src), 32));
+    }
+    EXPECT_TRUE(bitmapsMeshable(rows.bitmap(dst), rows.bitmap(src), 32));
+  }
+
+  return found.size();
+}
+
+static void pushRow(BitmapMirror &rows, std::initializer_list<size_t> offsets) {
+  uint64_t bits[BitmapMirror::kWords] = {};
+  for (const auto off : offsets) {
+    bits[off / 64] |= 1UL << (off % 64);
+  }
+  rows.push(bits, MiniHeapID{static_cast<uint32_t>(rows.size() + 1)}, 1);
+}
+
+TEST(MeshingTest, MeshersFindValidMeshes) {
+  std::mt19937 prng(0);
+  std::uniform_int_distribution<size_t> offset(0, 127);
+
+  for (size_t id = 0; id < method::MesherCount; id++) {
+    BitmapMirror rows{};
+    rows.setObjectCount(128);
+    for (size_t i = 0; i < 200; i++) {
+      uint64_t bits[BitmapMirror::kWords] = {};
+      for (size_t k = 0; k < 8; k++) {
+        const auto off = offset(prng);
+        bits[off / 64] |= 1UL << (off % 64);
+      }
+      rows.push(bits, MiniHeapID{static_cast<uint32_t>(i + 1)}, 1);
+    }
+
+    const auto count = checkMesher(method::mesherEntry(id).mesher, rows, 128);
+    ASSERT_GT(count, 0UL) << method::mesherEntry(id).name;
+  }
+}
+
+TEST(MeshingTest, MaxMatchingBeatsGreedy) {
+  // meshability graph is the path a - b - c - d.  By occupancy, greedy
+  // pairs b with c and strands a and d; matching the degree-one ends
+  // first meshes everything.
+  BitmapMirror rows{};
+  pushRow(rows, {0, 1});  // a
+  pushRow(rows, {2});     // b
+  pushRow(rows, {0});     // c
+  pushRow(rows, {1, 2});  // d
+
+  ASSERT_EQ(checkMesher(method::greedyRows, rows, 64), 1UL);
+  ASSERT_EQ(checkMesher(method::maxMatchingRows, rows, 64), 2UL);
+}
+
+TEST(MeshingTest, BitmapSignatures) {
+  BitmapMirror rows{};
+  pushRow(rows, {});
+  pushRow(rows, {0, 31});
+  pushRow(rows, {32, 255});
+  ASSERT_EQ(rows.signature(0), 0);
+  ASSERT_EQ(rows.signature(1), 0x01);
+  ASSERT_EQ(rows.signature(2), 0x82);
+
+  // 40-object spans: 5 objects per chunk
+  BitmapMirror small{};
+  small.setObjectCount(40);
+  pushRow(small, {4, 5, 39});
+  ASSERT_EQ(small.signature(0), 0x83);
+
+  // signatures move with their rows
+  rows.swap(1, 2);
+  ASSERT_EQ(rows.signature(1), 0x82);
+  rows.pop();
+  ASSERT_EQ(rows.size(), 2UL);
+  ASSERT_EQ(rows.signature(1), 0x82);
+}
+
+TEST(MeshingTest, SignatureMesherSkipsComparisons) {
+  // every row lives in a single chunk, so all pairs are found through
+  // disjoint signatures without comparing a bitmap
+  BitmapMirror rows{};
+  for (size_t i = 0; i < 64; i++) {
+    pushRow(rows, {(i % 8) * 32 + i / 8});
+  }
+
+  MWC prng(internal::seed(), internal::seed());
+  size_t found = 0;
+  const auto comparisons = method::signatureRows(prng, rows, 256, [&](size_t dst, size_t src) {
+    ASSERT_TRUE(bitmapsMeshable(rows.bitmap(dst), rows.bitmap(src), 32));
+    found++;
+  });
+  ASSERT_EQ(found, 32UL);
+  ASSERT_EQ(comparisons, 0UL);
+}
+
+TEST(MeshingTest, MesherByName) {
+  for (size_t id = 0; id < method::MesherCount; id++) {
+    ASSERT_EQ(method::mesherByName(method::mesherEntry(id).name), static_cast<ssize_t>(id));
+  }
+  ASSERT_EQ(method::mesherByName("nonexistent"), -1);
+}
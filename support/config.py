@@ -77,6 +77,8 @@ class ConfigBuilder:
                             help='0: no randomization. 1: freelist init only.  2: freelist init + free fastpath (default)')
         parser.add_argument('--disable-meshing', action='store_true', default=False,
                             help='disable meshing')
+        parser.add_argument('--steer-placement', action='store_true', default=False,
+                            help='hand out complementary halves of each span first, to keep spans meshable')
         parser.add_argument('--suffix', action='store_true', default=False,
                             help='always suffix the mesh binary with randomization + meshing info')
 
@@ -106,12 +108,19 @@ class ConfigBuilder:
         else:
             self.config_int('meshing-enabled', 1)
 
+        if args.steer_placement:
+            self.config_int('steered-placement', 1)
+        else:
+            self.config_int('steered-placement', 0)
+
         if args.suffix:
             suffix = str(args.randomization)
             if args.disable_meshing:
                 suffix = suffix + 'n'
             else:
                 suffix = suffix + 'y'
+            if args.steer_placement:
+                suffix = suffix + 's'
             self.append('lib_suffix', suffix)
 
 